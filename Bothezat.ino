@@ -8,8 +8,11 @@
 
 #include "i2c.h"
 #include "motion_sensor.h"
+#include "barometer.h"
 #include "receiver.h"
 #include "pwm_receiver.h"
+#include "ppm_receiver.h"
+#include "serial_receiver.h"
 #include "flight_system.h"
 #include "motor_controller.h"
 #include "aux_functions.h"
@@ -37,6 +40,7 @@ private:
 	// Modules
 	Receiver* receiver;
 	MotionSensor* motionSensor;
+	Barometer* barometer;
 	LedController* ledController;
 	FlightSystem* flightSystem;
 	MotorController* motorController;
@@ -78,10 +82,26 @@ public:
 		Timer::EnableTimers();
 
 		// Construct other modules
-		Receiver::SetReceiver(PwmReceiver::Instance());
+		switch (config.RX_RECEIVER_TYPE)
+		{
+			case Receiver::RECEIVER_PPM:
+				Receiver::SetReceiver(PpmReceiver::Instance());
+				break;
+
+			case Receiver::RECEIVER_SBUS:
+			case Receiver::RECEIVER_SPEKTRUM:
+				Receiver::SetReceiver(SerialReceiver::Instance());
+				break;
+
+			case Receiver::RECEIVER_PWM:
+			default:
+				Receiver::SetReceiver(PwmReceiver::Instance());
+				break;
+		}
 
 		receiver = &Receiver::CurrentReceiver();
 		motionSensor = &MotionSensor::Instance();
+		barometer = &Barometer::Instance();
 		flightSystem = &FlightSystem::Instance();
 		auxFunctions = &AuxFunctions::Instance();
 		stickCommands = &StickCommands::Instance();
@@ -91,6 +111,7 @@ public:
 		// Initialize modules
 		receiver->Setup();
 		motionSensor->Setup();
+		barometer->Setup();
 		flightSystem->Setup();
 		auxFunctions->Setup();
 		stickCommands->Setup();
@@ -111,8 +132,6 @@ public:
 		debugTime = 0;
 		loopStart = lastLoopStart = timer->Micros();
 
-		BrokenWindow();
-
 		Debug::Print("Initialization complete!\n");
 	}
 
@@ -124,43 +143,23 @@ public:
 		serialInterface->RegisterResourceProvider(Page::Resource::ACCEL_ORIENTATION, 	motionSensor);
 		serialInterface->RegisterResourceProvider(Page::Resource::ACCELERATION, 		motionSensor);
 		serialInterface->RegisterResourceProvider(Page::Resource::ANGULAR_VELOCITY, 	motionSensor);
+		serialInterface->RegisterResourceProvider(Page::Resource::ALTITUDE, 			barometer);
 
 		serialInterface->RegisterResourceProvider(Page::Resource::RECEIVER_CHANNELS, 	receiver);
 		serialInterface->RegisterResourceProvider(Page::Resource::RECEIVER_NORMALIZED, 	receiver);
 		serialInterface->RegisterResourceProvider(Page::Resource::RECEIVER_CONNECTED,	receiver);
-		serialInterface->RegisterResourceProvider(Page::Resource::RECEIVER_CONNECTED,	receiver);
+		serialInterface->RegisterResourceProvider(Page::Resource::RECEIVER_STATS,		receiver);
+
+		serialInterface->RegisterResourceProvider(Page::Resource::MIXER_SATURATION,		motorController);
+		serialInterface->RegisterResourceProvider(Page::Resource::AUTOTUNE_STATE,		motorController);
 	}
 
 	void RegisterCommandHandlers()
 	{
 		serialInterface->RegisterCommandHandler(Command::SAVE_CONFIG, 					&config);
 		serialInterface->RegisterCommandHandler(Command::RESET_CONFIG, 					&config);
-	}
 
-	void BrokenWindow()
-	{
-		// Aux control functions
-		AuxFunctions::ControlFunction angleModeFunction;
-		angleModeFunction.type = AuxFunctions::ControlFunction::ENABLE_ANGLE_MODE;
-		angleModeFunction.channel = Receiver::AUX1;
-		angleModeFunction.min = 0.0f;
-		angleModeFunction.max = 1.0f;
-
-		auxFunctions->AddControlFunction(angleModeFunction);
-
-		// Stick commands
-		StickCommands::Command armCommand;
-		armCommand.type = StickCommands::Command::ARM_MOTORS;
-		armCommand.SetStickState(Receiver::THROTTLE, -1);
-		armCommand.SetStickState(Receiver::RUDDER, -1);
-
-		StickCommands::Command disarmCommand;
-		disarmCommand.type = StickCommands::Command::DISARM_MOTORS;
-		disarmCommand.SetStickState(Receiver::THROTTLE, -1);
-		disarmCommand.SetStickState(Receiver::RUDDER, 1);
-
-		stickCommands->AddCommand(armCommand);
-		stickCommands->AddCommand(disarmCommand);
+		serialInterface->RegisterCommandHandler(Command::START_AUTOTUNE, 				motorController);
 	}
 
 	void Loop()
@@ -175,6 +174,7 @@ public:
 
 		receiver->Loop(dt);
 		motionSensor->Loop(dt);
+		barometer->Loop(dt);
 		//ledController->Loop(dt);
 		flightSystem->Loop(dt);
 		auxFunctions->Loop(dt);
@@ -189,6 +189,7 @@ public:
 		if (debugTime >= 1000000L)
 		{
 			//motionSensor->Debug();
+			//barometer->Debug();
 			//receiver->Debug();
 			//flightSystem->Debug();
 			motorController->Debug();
@@ -0,0 +1,58 @@
+#ifndef _ALTITUDE_ESTIMATOR_H_
+#define _ALTITUDE_ESTIMATOR_H_
+
+namespace bothezat
+{
+
+/*
+ *	Complementary filter that estimates altitude and vertical velocity. Has no hardware dependencies so it can also be compiled on a host.
+ *
+ *	Vertical acceleration is integrated every loop, which follows fast changes but drifts. The difference with the
+ *	barometric altitude, which is noisy but does not drift, is fed back into both the velocity and the altitude.
+ *	The feedback gains place both poles at 1 / timeConstant, so the filter is critically damped.
+ */
+class AltitudeEstimator
+{
+
+private:
+	float altitude, velocity;
+
+	// Feedback gains for the altitude and velocity
+	float altitudeGain, velocityGain;
+
+public:
+	AltitudeEstimator() : altitude(0.0f), velocity(0.0f), altitudeGain(0.0f), velocityGain(0.0f)
+	{
+
+	}
+
+	// Time constant (s) below which the accelerometer is trusted over the barometer
+	void SetTimeConstant(float timeConstant)
+	{
+		altitudeGain = 2.0f / timeConstant;
+		velocityGain = 1.0f / (timeConstant * timeConstant);
+	}
+
+	void Reset(float altitude)
+	{
+		this->altitude = altitude;
+		velocity = 0.0f;
+	}
+
+	// Advances the estimate with the vertical acceleration (m/s^2, gravity removed) and the last barometric altitude (m)
+	void Update(float acceleration, float baroAltitude, float dt)
+	{
+		float error = baroAltitude - altitude;
+
+		velocity += (acceleration + velocityGain * error) * dt;
+		altitude += (velocity + altitudeGain * error) * dt;
+	}
+
+	float Altitude() const { return altitude; }
+	float VerticalVelocity() const { return velocity; }
+
+};
+
+}
+
+#endif
@@ -4,68 +4,280 @@
 #include "Arduino.h"
 
 #include "binary_stream.h"
+#include "ring_buffer.h"
 
 namespace bothezat
 {
 
+/*
+ *	Serial port which never blocks on writes. Written data is queued and moved to the serial TX buffer
+ *	as far as it has room, whenever a message is reserved and on every Update().
+ *
+ *	The platform port is accessed through the functions implemented by ArduinoSerialPort.
+ */
 class SerialPort : public BinaryStream
 {
+public:
+	enum Priority
+	{
+		// Telemetry and logs, dropped first when the queue fills up
+		PRIORITY_LOW = 0,
+
+		// Responses to requests of the host
+		PRIORITY_HIGH
+	};
+
+	static const uint32_t TX_BUFFER_SIZE = 1024 * 4;
+
+	// Space in the queue that only high priority messages can use
+	static const uint32_t TX_RESERVED = 1024;
 
 private:
-	// The arduino platform serial port
-	HardwareSerial& serial;
+	// Data waiting for room in the serial TX buffer
+	RingBuffer txBuffer;
 
-public:
-	SerialPort(HardwareSerial& serial) : serial(serial)
+	// Messages that didn't fit in the queue
+	uint32_t droppedMessages;
+
+	bool started;
+
+	// Whether a host was listening at the last UpdateConnection()
+	bool connected;
+
+	SerialPort(const SerialPort& other);
+	SerialPort& operator=(const SerialPort& other);
+
+protected:
+	SerialPort() : droppedMessages(0), started(false), connected(false)
 	{
 
 	}
 
+	// Whether a host is listening on the port, may be slow to determine
+	virtual bool PortConnected() = 0;
+
+	virtual void PortBegin(uint32_t baudRate) = 0;
+	virtual void PortEnd() = 0;
+
+	virtual uint32_t PortAvailable() = 0;
+	virtual uint32_t PortRead(uint8_t* buffer, uint32_t length) = 0;
+	virtual uint8_t PortReadByte() = 0;
+
+	virtual uint32_t PortAvailableForWrite() = 0;
+	virtual void PortWrite(const uint8_t* buffer, uint32_t length) = 0;
+
+public:
+	// Whether a host is listening, nothing is queued while it isn't
+	bool IsConnected() const { return connected; }
+
+	// Bytes per second the port can transfer
+	virtual uint32_t Bandwidth() const = 0;
+
+	virtual const char* Name() const = 0;
+
+	// Allocates the queue once the port is used, messages from before Begin() are queued as well
+	void Open()
+	{
+		if (txBuffer.Size() == 0)
+			txBuffer.Allocate(TX_BUFFER_SIZE);
+	}
+
 	void Begin(uint32_t baudRate)
 	{
-		serial.begin(baudRate);
+		PortBegin(baudRate);
+		started = true;
+
+		UpdateConnection();
+	}
+
+	// Queries the port for a listening host. Messages are reserved far more often than this, so they use the latched state
+	void UpdateConnection()
+	{
+		connected = PortConnected();
 	}
 
 	void End()
 	{
-		serial.end();
+		PortEnd();
+		started = false;
+	}
+
+	// Moves as much queued data to the serial TX buffer as fits without blocking
+	void Update()
+	{
+		if (!started)
+			return;
+
+		while (txBuffer.readStream.Available() > 0)
+		{
+			uint32_t writable = PortAvailableForWrite();
+
+			if (writable == 0)
+				break;
+
+			// Write straight from the queue, the data is in at most two pieces when it wraps around
+			const uint8_t* span;
+			uint32_t length = min(writable, txBuffer.readStream.PeekSpan(span));
+
+			PortWrite(span, length);
+			txBuffer.readStream.Commit(length);
+		}
+
+		// Release the space of the data that was sent
+		txBuffer.Trim();
+	}
+
+	// Checks if a message of the given size can be queued, a message that can't shouldn't be written
+	bool Reserve(uint32_t size, Priority priority)
+	{
+		if (started && !connected)
+			return false;
+
+		Update();
+
+		if (size <= WritableBytes(priority))
+			return true;
+
+		++droppedMessages;
+		return false;
+	}
+
+	// Bytes that messages of the given priority can still queue
+	uint32_t WritableBytes(Priority priority)
+	{
+		uint32_t free = txBuffer.FreeBytes();
+
+		if (priority == PRIORITY_HIGH)
+			return free;
+
+		return free > TX_RESERVED ? free - TX_RESERVED : 0;
 	}
-	
+
+	uint32_t DroppedMessages() const { return droppedMessages; }
+
 	uint32_t Available() const
 	{
-		return serial.available();
+		return const_cast<SerialPort*>(this)->PortAvailable();
 	}
 
 	uint32_t Seek(int32_t amount)
 	{
 		assert(amount >= 0 && "Serial stream can only seek forward");
 
-		while (amount > 0)
+		uint32_t skipped = 0;
+
+		while (amount > 0 && PortAvailable() > 0)
 		{
-			serial.read();
+			PortReadByte();
 			--amount;
+			++skipped;
 		}
+
+		return skipped;
 	}
 
 	uint32_t Read(uint8_t* buffer, uint32_t length, bool peek = false)
 	{
 		assert(!peek && "Peek reading not supported on Arduino serial port");
-		return serial.readBytes(buffer, length);
+		return PortRead(buffer, length);
 	}
 
 	uint32_t Write(const uint8_t* buffer, uint32_t size)
 	{
-		return serial.write(buffer, size);
+		return txBuffer.writeStream.Write(buffer, size);
+	}
+
+};
+
+/*
+ *	Serial port on one of the Arduino serial classes: HardwareSerial for the UARTs, Serial_ for the native USB port
+ */
+template <class Port>
+class ArduinoSerialPort : public SerialPort
+{
+
+private:
+	// The arduino platform serial port
+	Port& port;
+
+	const char* name;
+
+	// Bytes per second, zero means the baud rate determines it
+	uint32_t bandwidth;
+
+	uint32_t baudRate;
+
+public:
+	ArduinoSerialPort(Port& port, const char* name, uint32_t bandwidth = 0) : port(port), name(name), bandwidth(bandwidth), baudRate(0)
+	{
+
+	}
+
+	uint32_t Bandwidth() const
+	{
+		// 10 bits per byte with start and stop bit
+		return bandwidth > 0 ? bandwidth : baudRate / 10;
+	}
+
+	const char* Name() const { return name; }
+
+protected:
+	bool PortConnected()
+	{
+		return port;
+	}
+
+	void PortBegin(uint32_t baudRate)
+	{
+		this->baudRate = baudRate;
+		port.begin(baudRate);
+	}
+
+	void PortEnd()
+	{
+		port.end();
+	}
+
+	uint32_t PortAvailable()
+	{
+		return port.available();
+	}
+
+	uint32_t PortRead(uint8_t* buffer, uint32_t length)
+	{
+		return port.readBytes(buffer, length);
+	}
+
+	uint8_t PortReadByte()
+	{
+		return port.read();
 	}
 
-	static SerialPort& Instance()
+	uint32_t PortAvailableForWrite()
 	{
-		static SerialPort instance(Serial);
+		return port.availableForWrite();
+	}
 
-		return instance;
+	void PortWrite(const uint8_t* buffer, uint32_t length)
+	{
+		port.write(buffer, length);
 	}
+
 };
 
+// Programming port, through the UART and the USB bridge of the 16U2
+typedef ArduinoSerialPort<HardwareSerial> UartSerialPort;
+
+// Native USB port, the baud rate is ignored and data moves at USB full speed
+typedef ArduinoSerialPort<Serial_> UsbSerialPort;
+
+// Serial_::operator bool() waits 10 ms before it returns the line state, the USB configuration is read without delay
+template <>
+inline bool ArduinoSerialPort<Serial_>::PortConnected()
+{
+	return USBDevice.configured();
+}
+
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -9,7 +9,7 @@
 
 using namespace bothezat;
 
-AuxFunctions::AuxFunctions() : registeredFunctions(0), receiver(NULL), flightSystem(NULL), motorController(NULL)
+AuxFunctions::AuxFunctions() : receiver(NULL), flightSystem(NULL), motorController(NULL), normalizedRevision(0), configRevision(0), elapsed(0)
 {
 	
 }
@@ -23,48 +23,80 @@ void AuxFunctions::Setup()
 
 void AuxFunctions::Loop(uint32_t dt)
 {
-	for (uint8_t functionIdx = 0; functionIdx < registeredFunctions; ++functionIdx)
+	// Rules might have moved around, start over without deactivating anything
+	if (configRevision != config.Revision())
 	{
-		ControlFunction& function = functions[functionIdx];
-		float value = receiver->NormalizedChannel(function.channel);
-		bool inRange = value >= function.min && value <= function.max;
-
-		if (inRange && !function.active)
-			ActivateFunction(function);
-		else if (!inRange && function.active)
-			DeactivateFunction(function);
+		for (uint8_t functionIdx = 0; functionIdx < Config::Constants::AC_MAX_CONTROL_FUNCTIONS; ++functionIdx)
+			states[functionIdx] = SwitchEvaluator::State();
+
+		configRevision = config.Revision();
 	}
-}
 
-void AuxFunctions::AddControlFunction(ControlFunction& function)
-{
-	if (registeredFunctions >= Config::Constants::AC_MAX_CONTROL_FUNCTIONS)
+	elapsed += dt;
+
+	// Nothing can change until the receiver has new values
+	if (receiver->NormalizedRevision() == normalizedRevision)
 		return;
 
-	functions[registeredFunctions++] = function;
+	normalizedRevision = receiver->NormalizedRevision();
+
+	const float* channels = receiver->NormalizedChannels();
+
+	SwitchEvaluator::Edge edges[Config::Constants::AC_MAX_CONTROL_FUNCTIONS];
+
+	for (uint8_t functionIdx = 0; functionIdx < Config::Constants::AC_MAX_CONTROL_FUNCTIONS; ++functionIdx)
+		edges[functionIdx] = SwitchEvaluator::Evaluate(config.AC_CONTROL_FUNCTIONS[functionIdx], states[functionIdx], channels, elapsed);
+
+	// Deactivate before activating, so a switch moving from one mode rule to another ends up in the new mode regardless of rule order
+	for (uint8_t functionIdx = 0; functionIdx < Config::Constants::AC_MAX_CONTROL_FUNCTIONS; ++functionIdx)
+	{
+		if (edges[functionIdx] == SwitchEvaluator::EDGE_DEACTIVATED)
+			DeactivateFunction(config.AC_CONTROL_FUNCTIONS[functionIdx].action);
+	}
+
+	for (uint8_t functionIdx = 0; functionIdx < Config::Constants::AC_MAX_CONTROL_FUNCTIONS; ++functionIdx)
+	{
+		if (edges[functionIdx] == SwitchEvaluator::EDGE_ACTIVATED)
+			ActivateFunction(config.AC_CONTROL_FUNCTIONS[functionIdx].action);
+	}
+
+	elapsed = 0;
 }
 
-void AuxFunctions::ActivateFunction(ControlFunction& function)
+void AuxFunctions::ActivateFunction(uint8_t type)
 {
-	switch (function.type)
+	switch (type)
 	{
 		case ControlFunction::ENABLE_ANGLE_MODE:
 			flightSystem->SwitchMode(FlightMode::ANGLE);
 			break;
 
+		case ControlFunction::ENABLE_RATE_MODE:
+			flightSystem->SwitchMode(FlightMode::RATE);
+			break;
+
+		case ControlFunction::ENABLE_HORIZON_MODE:
+			flightSystem->SwitchMode(FlightMode::HORIZON);
+			break;
+
+		case ControlFunction::ENABLE_ALTITUDE_HOLD:
+			flightSystem->SwitchMode(FlightMode::ALTITUDE_HOLD);
+			break;
+
 		case ControlFunction::ARM_MOTORS:
 			motorController->SetArmState(true);
 			break;
 	}
-
-	function.active = true;
 }
 
-void AuxFunctions::DeactivateFunction(ControlFunction& function)
+void AuxFunctions::DeactivateFunction(uint8_t type)
 {
-	switch (function.type)
+	switch (type)
 	{
 		case ControlFunction::ENABLE_ANGLE_MODE:
+		case ControlFunction::ENABLE_RATE_MODE:
+		case ControlFunction::ENABLE_HORIZON_MODE:
+		case ControlFunction::ENABLE_ALTITUDE_HOLD:
 			flightSystem->SwitchMode(FlightSystem::DEFAULT_MODE);
 			break;
 
@@ -72,6 +104,4 @@ void AuxFunctions::DeactivateFunction(ControlFunction& function)
 			motorController->SetArmState(false);
 			break;
 	}
-
-	function.active = false;
 }
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include "module.h"
 
 #include "receiver.h"
+#include "switch_evaluator.h"
 
 namespace bothezat
 {
@@ -13,6 +14,9 @@ namespace bothezat
 class FlightSystem;
 class MotorController;
 
+/*
+ *	Activates functions while aux channels are in a range, as configured by the AC_CONTROL_FUNCTIONS rules
+ */
 class AuxFunctions : public Module<AuxFunctions>
 {
 friend class Module<AuxFunctions>;
@@ -21,32 +25,21 @@ public:
 
 	struct ControlFunction
 	{
+		// Action of an aux function rule in the config, active while the rule is
 		enum Type
 		{
 			UNKNOWN,
 
 			ENABLE_ANGLE_MODE,
+			ENABLE_RATE_MODE,
+			ENABLE_HORIZON_MODE,
+			ENABLE_ALTITUDE_HOLD,
 			ARM_MOTORS,
 		};
-
-		Type type;
-
-		Receiver::Channel channel;
-
-		float min, max;
-
-		bool active;
-
-		ControlFunction() : active(false), type(UNKNOWN)
-		{
-			min = 0.0f;
-			max = 1.0f;
-		}
 	};
 
-	ControlFunction functions[Config::Constants::AC_MAX_CONTROL_FUNCTIONS];
-
-	uint8_t registeredFunctions;
+private:
+	SwitchEvaluator::State states[Config::Constants::AC_MAX_CONTROL_FUNCTIONS];
 
 	Receiver* receiver;
 
@@ -54,6 +47,10 @@ public:
 
 	MotorController* motorController;
 
+	// Normalized receiver values and config the rules were last evaluated for, and the time since
+	uint32_t normalizedRevision, configRevision;
+	uint32_t elapsed;
+
 protected:
 	AuxFunctions();
 
@@ -62,12 +59,10 @@ public:
 
 	virtual void Loop(uint32_t dt);
 
-	void AddControlFunction(ControlFunction& function);
-
 private:
 
-	void ActivateFunction(ControlFunction& function);
-	void DeactivateFunction(ControlFunction& function);
+	void ActivateFunction(uint8_t type);
+	void DeactivateFunction(uint8_t type);
 
 };
 
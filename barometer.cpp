@@ -0,0 +1,184 @@
+#include "Arduino.h"
+#include "bothezat.h"
+
+#include "barometer.h"
+#include "motion_sensor.h"
+
+#include "i2c.h"
+
+using namespace bothezat;
+
+Barometer::Barometer() :
+	motionSensor(NULL), state(DISABLED), conversionTime(0), pressureSamples(0), rawTemperature(0),
+	temperature(0), pressure(0), groundPressure(0.0f), baroAltitude(0.0f)
+{
+
+}
+
+void Barometer::Setup()
+{
+	motionSensor = &MotionSensor::Instance();
+
+	estimator.SetTimeConstant(config.BR_ESTIMATOR_TC);
+
+	// The PROM is reloaded after a reset
+	I2C::Write(MS5611_I2C_ADDRESS, MS5611_RESET, NULL, 0);
+	delayMicroseconds(MS5611_RESET_TIME);
+
+	if (!ReadProm())
+	{
+		Debug::Print("No barometer found\n");
+		return;
+	}
+
+	// Take a first temperature and pressure sample to use as reference, setup is allowed to wait for this
+	uint32_t rawPressure;
+
+	StartConversion(MS5611_CONVERT_D2 + OSR);
+	delayMicroseconds(CONVERSION_TIME);
+	ReadConversion(rawTemperature);
+
+	StartConversion(MS5611_CONVERT_D1 + OSR);
+	delayMicroseconds(CONVERSION_TIME);
+	ReadConversion(rawPressure);
+
+	MS5611::Compensate(prom, rawPressure, rawTemperature, temperature, pressure);
+	groundPressure = pressure;
+
+	Debug::Print("Barometer ground pressure: %d Pa; Temperature: %.2f C\n", pressure, temperature * 0.01f);
+
+	estimator.Reset(0.0f);
+
+	// Start the continuous conversions
+	state = CONVERTING_PRESSURE;
+	StartConversion(MS5611_CONVERT_D1 + OSR);
+}
+
+void Barometer::Loop(uint32_t dt)
+{
+	if (state == DISABLED)
+		return;
+
+	conversionTime += dt;
+
+	if (conversionTime >= CONVERSION_TIME)
+	{
+		uint32_t value;
+
+		if (ReadConversion(value))
+		{
+			if (state == CONVERTING_TEMPERATURE)
+				rawTemperature = value;
+			else
+				UpdatePressure(value);
+		}
+
+		// Every few pressure samples the temperature is updated
+		if (state == CONVERTING_PRESSURE && ++pressureSamples >= TEMPERATURE_INTERVAL)
+		{
+			pressureSamples = 0;
+			state = CONVERTING_TEMPERATURE;
+			StartConversion(MS5611_CONVERT_D2 + OSR);
+		}
+		else
+		{
+			state = CONVERTING_PRESSURE;
+			StartConversion(MS5611_CONVERT_D1 + OSR);
+		}
+	}
+
+	estimator.Update(VerticalAcceleration(), baroAltitude, dt * 1e-6f);
+}
+
+void Barometer::Debug() const
+{
+	Debug::Print("Barometer:\n");
+	Debug::Print("Pressure: %d Pa; Temperature: %.2f C; Baro altitude: %.2f m\n", pressure, temperature * 0.01f, baroAltitude);
+	Debug::Print("Altitude: %.2f m; Vertical velocity: %.2f m/s\n", Altitude(), VerticalVelocity());
+}
+
+uint16_t Barometer::SerializeResource(Page::Resource::Type type, BinaryWriteStream& stream)
+{
+	switch (type)
+	{
+		case Page::Resource::ALTITUDE:
+			stream.Write(Altitude());
+			stream.Write(VerticalVelocity());
+			stream.Write(baroAltitude);
+
+			return sizeof(float) * 3;
+	}
+
+	return 0;
+}
+
+bool Barometer::ReadProm()
+{
+	for (uint8_t address = 0; address < MS5611_PROM_SIZE; ++address)
+	{
+		uint8_t error = I2C::Read(MS5611_I2C_ADDRESS, MS5611_PROM_READ + address * 2, (uint8_t*) &prom[address], sizeof(uint16_t));
+
+		if (error != I2C::ERR_OK)
+			return false;
+
+		// PROM words are sent MSB first
+		Util::SwapEndianness((uint8_t*) &prom[address], sizeof(uint16_t));
+	}
+
+	if (!MS5611::CheckCRC(prom))
+	{
+		Debug::Print("Barometer PROM CRC mismatch\n");
+		return false;
+	}
+
+	return true;
+}
+
+bool Barometer::StartConversion(uint8_t command)
+{
+	conversionTime = 0;
+
+	uint8_t error = I2C::Write(MS5611_I2C_ADDRESS, command, NULL, 0);
+
+	if (error != I2C::ERR_OK)
+	{
+		Debug::Print("I2C error while starting barometer conversion: %d\n", error);
+		return false;
+	}
+
+	return true;
+}
+
+bool Barometer::ReadConversion(uint32_t& value)
+{
+	uint8_t data[3];
+	uint8_t error = I2C::Read(MS5611_I2C_ADDRESS, MS5611_ADC_READ, data, sizeof(data));
+
+	if (error != I2C::ERR_OK)
+	{
+		Debug::Print("I2C error while reading barometer: %d\n", error);
+		return false;
+	}
+
+	value = ((uint32_t) data[0] << 16) | ((uint32_t) data[1] << 8) | data[2];
+
+	// The ADC reads zero if it was read before the conversion finished
+	return value != 0;
+}
+
+void Barometer::UpdatePressure(uint32_t rawPressure)
+{
+	MS5611::Compensate(prom, rawPressure, rawTemperature, temperature, pressure);
+
+	// International barometric formula, relative to the ground pressure
+	baroAltitude = 44330.0f * (1.0f - pow(pressure / groundPressure, 0.190295f));
+}
+
+float Barometer::VerticalAcceleration() const
+{
+	// Rotate the measured acceleration to world space. In rest this points down with a length of 1G.
+	// The low pass filtered acceleration lags more than the time constant of the estimator, so the unfiltered one is used
+	Vector3 acceleration = motionSensor->CurrentOrientation() * motionSensor->RawAcceleration();
+
+	return (-acceleration.y - 1.0f) * GRAVITY;
+}
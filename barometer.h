@@ -0,0 +1,99 @@
+#ifndef _BAROMETER_H_
+#define _BAROMETER_H_
+
+#include "Arduino.h"
+
+#include "module.h"
+
+#include "ms5611.h"
+#include "altitude_estimator.h"
+
+namespace bothezat
+{
+
+class MotionSensor;
+
+/*
+ *	Reads an MS5611 barometer and estimates altitude and vertical velocity from it together with the accelerometer.
+ *	Conversions are started and read in a state machine, so the loop never waits for the sensor.
+ */
+class Barometer : public Module<Barometer>, public ResourceProvider
+{
+friend class Module<Barometer>;
+
+public:
+	enum State
+	{
+		// No sensor responded during setup
+		DISABLED = 0,
+
+		CONVERTING_PRESSURE,
+		CONVERTING_TEMPERATURE
+	};
+
+	// Oversampling ratio used for both conversions, and the time it takes to convert with it
+	static const uint8_t OSR = MS5611_OSR_1024;
+	static const uint32_t CONVERSION_TIME = MS5611_CONVERSION_1024;
+
+	// Amount of pressure conversions between temperature conversions
+	static const uint8_t TEMPERATURE_INTERVAL = 8;
+
+	static const float GRAVITY = 9.81f;
+
+private:
+	MotionSensor* motionSensor;
+
+	State state;
+
+	uint16_t prom[MS5611_PROM_SIZE];
+
+	// Time since the current conversion was started (us)
+	uint32_t conversionTime;
+
+	uint8_t pressureSamples;
+
+	// Last raw temperature value, used to compensate pressure samples
+	uint32_t rawTemperature;
+
+	int32_t temperature, pressure;
+
+	// Pressure at the moment of setup, altitude is relative to this
+	float groundPressure;
+
+	float baroAltitude;
+
+	AltitudeEstimator estimator;
+
+protected:
+	Barometer();
+
+public:
+	virtual void Setup();
+	virtual void Loop(uint32_t dt);
+	virtual void Debug() const;
+
+	virtual uint16_t SerializeResource(Page::Resource::Type type, BinaryWriteStream& stream);
+
+	bool IsAvailable() const { return state != DISABLED; }
+
+	// Estimated altitude (m) above the altitude at startup
+	float Altitude() const { return estimator.Altitude(); }
+
+	// Estimated vertical velocity (m/s), positive is up
+	float VerticalVelocity() const { return estimator.VerticalVelocity(); }
+
+private:
+	bool ReadProm();
+
+	bool StartConversion(uint8_t command);
+	bool ReadConversion(uint32_t& value);
+
+	void UpdatePressure(uint32_t rawPressure);
+
+	float VerticalAcceleration() const;
+
+};
+
+}
+
+#endif
@@ -53,6 +53,9 @@ class BinaryReadStream
 {
 
 public:
+	// Bytes ReadTo copies at once
+	static const uint32_t READ_TO_CHUNK_SIZE = 32;
+
 	virtual uint32_t Available() const = 0;
 	virtual uint32_t Seek(int32_t amount) = 0;
 
@@ -131,8 +134,19 @@ public:
 
 	void ReadTo(BinaryWriteStream& stream, uint32_t length)
 	{
-		while (length-- > 0)
-			stream.Write(ReadByte());
+		uint8_t chunk[READ_TO_CHUNK_SIZE];
+
+		while (length > 0)
+		{
+			uint32_t bytesRead = Read(chunk, length < READ_TO_CHUNK_SIZE ? length : READ_TO_CHUNK_SIZE);
+			assert(bytesRead > 0);
+
+			if (bytesRead == 0)
+				break;
+
+			stream.Write(chunk, bytesRead);
+			length -= bytesRead;
+		}
 	}
 
 	virtual uint32_t Read(uint8_t* buffer, uint32_t length, bool peek = false) = 0;
@@ -16,6 +16,8 @@ struct Command
 
 		CALIBRATE_ACCELEROMETER	= 0x10,
 
+		START_AUTOTUNE			= 0x20,
+
 		INVALID_COMMAND			= 0xFF
 	};
 
@@ -8,7 +8,7 @@ Config Config::instance;
 
 DueFlashStorage flash;
 
-Config::Config() : buffer(NULL), SerializableResource(Page::Resource::CONFIG, *this)
+Config::Config() : buffer(NULL), revision(0), SerializableResource(Page::Resource::CONFIG, *this)
 {
 	bufferSize = SerializedSize();
 
@@ -65,11 +65,28 @@ void Config::LoadDefaults()
 	 * Serial interface
 	 */
 	SR_BAUD_RATE 				= 115200; 		// Baud rate for serial communication
+	SR_TELEMETRY_SHARE			= 0.5f;			// Share of the serial bandwidth that telemetry subscriptions may use
+	SR_USB_ENABLED				= 1;			// Whether the native USB port also runs the configuration protocol
 
 	/*
 	 * Radio receiver 
 	 */
-	
+	RX_RECEIVER_TYPE			= 0;			// Type of receiver connected, see Receiver::Type
+	// Input channel for each receiver channel, in Receiver::Channel order. Defaults to the Spektrum order (throttle, aileron, elevator, rudder)
+	for (uint8_t channel = 0; channel < Constants::RX_MAX_CHANNELS; ++channel)
+		RX_CHANNEL_MAPPING[channel] = ChannelMapping(channel);
+
+	RX_CHANNEL_MAPPING[0] 		= ChannelMapping(1);
+	RX_CHANNEL_MAPPING[1] 		= ChannelMapping(2);
+	RX_CHANNEL_MAPPING[2] 		= ChannelMapping(0);
+	RX_CHANNEL_MAPPING[3] 		= ChannelMapping(3);
+
+	RX_PULSE_MARGIN				= 100;			// Pulses (us) further than this outside the calibrated range are rejected as glitches
+	RX_SMOOTHING				= 1;			// Interpolate channels between frames, so setpoints change every loop instead of in steps
+	RX_FAILSAFE_HOLD_TIME		= 1.0f;			// Time (s) the last channel values are held after losing the link
+	RX_FAILSAFE_LEVEL_TIME		= 2.0f;			// Time (s) spent levelling at the failsafe throttle after holding
+	RX_FAILSAFE_DESCEND_TIME	= 10.0f;		// Time (s) over which the throttle is ramped down before disarming
+	RX_FAILSAFE_THROTTLE		= 0.4f;			// Throttle while levelling, and at the start of the descent
 
 	/*
 	 * Motion sensor
@@ -81,25 +98,73 @@ void Config::LoadDefaults()
 	MS_ACCEL_CORRECTION_RC		= 0.0002f;		// Lower means slower correction to gyro by accelerometer
 	MS_ACCEL_MAX				= 0.15f;		// Accelerometer values with a larger deviation from 1G than this will get discarded
 
+	/*
+	 * Barometer
+	 */
+	BR_ESTIMATOR_TC				= 1.0f;			// Time constant (s) of the altitude estimator, below this the accelerometer is trusted over the barometer
+
 	/*
 	 * Flight system
 	 */
 	FS_MAN_ANGULAR_VELOCITY		= Vector3(50.0f, 50.0f, 50.0f);	// Angular velocity at max stick input for manual mode
 	FS_ATTI_MAX_PITCH			= 45.0f;						// Pitch angle at max stick input for atti mode
 	FS_ATTI_MAX_ROLL			= 45.0f;						// Roll angle at max stick input for atti mode
+	FS_RATE_MAX					= Vector3(360.0f, 180.0f, 360.0f);	// Angular velocity (deg/s) at max stick input for rate mode
+	FS_RATE_EXPO				= 0.2f;							// Expo applied to the sticks in rate mode
+	FS_HORIZON_TRANSITION		= 0.75f;						// Stick deflection at which horizon mode stops self-levelling
+	FS_HORIZON_LEVEL_GAIN		= 4.0f;							// Angular velocity (deg/s) per degree of angle error when self-levelling
+	FS_TRANSITION_TIME			= 0.3f;							// Time (s) over which the setpoint is blended when switching flight modes
+	FS_ALT_MAX_CLIMB_RATE		= 1.0f;							// Climb rate (m/s) at full throttle deflection from the hover position in altitude hold mode
+	FS_ALT_PID_CONFIGURATION	= PidConfiguration(0.1f, 0.02f, 0.1f);	// Throttle per meter of altitude error in altitude hold mode
 
 	/*
 	 * Motor controller
 	 */
-	MC_PWM_FREQUENCY			= 50;
-	MC_PWM_PERIOD				= 20000;
-	MC_PWM_MIN_COMMAND			= 950;
+	MC_MIXER_LAYOUT				= 0;			// Airframe layout used by the mixer, see Mixer::Layout
+	MC_MIXER_MODE				= 0;			// How axis outputs are fitted in the motor output range, see MotorController::MixerMode
+	MC_OUTPUT_PROTOCOL			= 0;			// Protocol used to send commands to the ESCs, see MotorController::OutputProtocol
+	MC_PWM_MIN_COMMAND			= 950;			// Commands are in standard PWM pulse lengths (us), they are scaled to the output protocol
 	MC_PWM_MIN_OUTPUT			= 1100;
 	MC_PWM_MAX_COMMAND			= 2050;
+	MC_THRUST_LINEARIZATION		= 0.0f;			// Amount of quadratic thrust response to compensate for, zero disables linearization
+	MC_THROTTLE_MID				= 0.5f;			// Throttle stick position around which the throttle expo curve is centered
+	MC_THROTTLE_EXPO			= 0.0f;			// Expo applied to the throttle around the mid point
 
 	MC_PID_CONFIGURATION[0] 	= PidConfiguration(1.0f, 0.005f, 1.0f);
 	MC_PID_CONFIGURATION[1] 	= PidConfiguration(1.0f, 0.005f, 0.0f);
 	MC_PID_CONFIGURATION[2] 	= PidConfiguration(1.0f, 0.005f, 1.0f);
+
+	MC_RATE_PID_CONFIGURATION[0] 	= PidConfiguration(1.0f, 0.5f, 0.01f);
+	MC_RATE_PID_CONFIGURATION[1] 	= PidConfiguration(2.0f, 1.0f, 0.0f);
+	MC_RATE_PID_CONFIGURATION[2] 	= PidConfiguration(1.0f, 0.5f, 0.01f);
+
+	// Multipliers for the PID gains at each throttle breakpoint
+	for (uint8_t breakpoint = 0; breakpoint < Constants::MC_GAIN_BREAKPOINTS; ++breakpoint)
+		MC_GAIN_SCHEDULE[breakpoint] = PidConfiguration(1.0f, 1.0f, 1.0f);
+
+	MC_TPA_BREAKPOINT			= 0.5f;			// Throttle above which P and D gains are attenuated
+	MC_TPA_RATE					= 0.0f;			// Amount P and D gains are attenuated at full throttle, zero disables TPA
+
+	/*
+	 * Aux control
+	 */
+	for (uint8_t function = 0; function < Constants::AC_MAX_CONTROL_FUNCTIONS; ++function)
+		AC_CONTROL_FUNCTIONS[function] = SwitchRule();
+
+	// Angle mode while AUX1 is in the upper half, see AuxFunctions::ControlFunction
+	AC_CONTROL_FUNCTIONS[0]		= SwitchRule(1, 0.05f, 50).SetCondition(0, 4, 0.0f, 2.0f);
+
+	/*
+	 * Stick commands
+	 */
+	for (uint8_t command = 0; command < Constants::SC_MAX_COMMANDS; ++command)
+		SC_COMMANDS[command] = SwitchRule();
+
+	// Arm with throttle down and rudder left, disarm with throttle down and rudder right, see StickCommands::Command
+	SC_COMMANDS[0]				= SwitchRule(1, 0.05f, 500).SetCondition(0, 2, -2.0f, -0.85f).SetCondition(1, 3, -2.0f, -0.85f);
+	SC_COMMANDS[1]				= SwitchRule(2, 0.05f, 500).SetCondition(0, 2, -2.0f, -0.85f).SetCondition(1, 3, 0.85f, 2.0f);
+
+	++revision;
 }
 
 
@@ -120,13 +185,27 @@ void Config::Serialize(BinaryWriteStream& stream) const
 	 * Serial interface
 	 */
 	stream.Write(SR_BAUD_RATE);
+	stream.Write(SR_TELEMETRY_SHARE);
+	stream.Write(SR_USB_ENABLED);
 
 	/*
 	 * Radio receiver 
 	 */
+	stream.Write(RX_RECEIVER_TYPE);
+
 	for (uint8_t channel = 0; channel < Constants::RX_MAX_CHANNELS; ++channel)
 		RX_CHANNEL_CALIBRATION[channel].Serialize(stream);
 
+	for (uint8_t channel = 0; channel < Constants::RX_MAX_CHANNELS; ++channel)
+		RX_CHANNEL_MAPPING[channel].Serialize(stream);
+
+	stream.Write(RX_PULSE_MARGIN);
+	stream.Write(RX_SMOOTHING);
+	stream.Write(RX_FAILSAFE_HOLD_TIME);
+	stream.Write(RX_FAILSAFE_LEVEL_TIME);
+	stream.Write(RX_FAILSAFE_DESCEND_TIME);
+	stream.Write(RX_FAILSAFE_THROTTLE);
+
 	/*
 	 * Motion sensor
 	 */
@@ -137,6 +216,11 @@ void Config::Serialize(BinaryWriteStream& stream) const
 	stream.Write(MS_ACCEL_CORRECTION_RC);
 	stream.Write(MS_ACCEL_MAX);
 
+	/*
+	 * Barometer
+	 */
+	stream.Write(BR_ESTIMATOR_TC);
+
 	/*
 	 * Flight system
 	 */
@@ -145,17 +229,50 @@ void Config::Serialize(BinaryWriteStream& stream) const
 	stream.Write(FS_ATTI_MAX_PITCH);
 	stream.Write(FS_ATTI_MAX_ROLL);
 
+	FS_RATE_MAX.Serialize(stream);
+	stream.Write(FS_RATE_EXPO);
+	stream.Write(FS_HORIZON_TRANSITION);
+	stream.Write(FS_HORIZON_LEVEL_GAIN);
+	stream.Write(FS_TRANSITION_TIME);
+	stream.Write(FS_ALT_MAX_CLIMB_RATE);
+	FS_ALT_PID_CONFIGURATION.Serialize(stream);
+
 	/*
 	 * Motor controller
 	 */
-	stream.Write(MC_PWM_FREQUENCY);
-	stream.Write(MC_PWM_PERIOD);
+	stream.Write(MC_MIXER_LAYOUT);
+	stream.Write(MC_MIXER_MODE);
+	stream.Write(MC_OUTPUT_PROTOCOL);
 	stream.Write(MC_PWM_MIN_COMMAND);
 	stream.Write(MC_PWM_MIN_OUTPUT);
 	stream.Write(MC_PWM_MAX_COMMAND);
+	stream.Write(MC_THRUST_LINEARIZATION);
+	stream.Write(MC_THROTTLE_MID);
+	stream.Write(MC_THROTTLE_EXPO);
 
 	for (uint8_t axis = 0; axis < 3; ++axis)
 		MC_PID_CONFIGURATION[axis].Serialize(stream);
+
+	for (uint8_t axis = 0; axis < 3; ++axis)
+		MC_RATE_PID_CONFIGURATION[axis].Serialize(stream);
+
+	for (uint8_t breakpoint = 0; breakpoint < Constants::MC_GAIN_BREAKPOINTS; ++breakpoint)
+		MC_GAIN_SCHEDULE[breakpoint].Serialize(stream);
+
+	stream.Write(MC_TPA_BREAKPOINT);
+	stream.Write(MC_TPA_RATE);
+
+	/*
+	 * Aux control
+	 */
+	for (uint8_t function = 0; function < Constants::AC_MAX_CONTROL_FUNCTIONS; ++function)
+		AC_CONTROL_FUNCTIONS[function].Serialize(stream);
+
+	/*
+	 * Stick commands
+	 */
+	for (uint8_t command = 0; command < Constants::SC_MAX_COMMANDS; ++command)
+		SC_COMMANDS[command].Serialize(stream);
 }
 
 bool Config::Deserialize(BinaryReadStream& stream)
@@ -183,10 +300,27 @@ bool Config::Deserialize(BinaryReadStream& stream)
 	 * Serial interface
 	 */
 	SR_BAUD_RATE 				= stream.ReadUInt32();
+	SR_TELEMETRY_SHARE			= stream.ReadFloat();
+	SR_USB_ENABLED				= stream.ReadByte();
+
+	/*
+	 * Radio receiver 
+	 */
+	RX_RECEIVER_TYPE			= stream.ReadByte();
 
 	for (uint8_t channel = 0; channel < Constants::RX_MAX_CHANNELS; ++channel)
 		RX_CHANNEL_CALIBRATION[channel].Deserialize(stream);
 
+	for (uint8_t channel = 0; channel < Constants::RX_MAX_CHANNELS; ++channel)
+		RX_CHANNEL_MAPPING[channel].Deserialize(stream);
+
+	RX_PULSE_MARGIN				= stream.ReadUInt16();
+	RX_SMOOTHING				= stream.ReadByte();
+	RX_FAILSAFE_HOLD_TIME		= stream.ReadFloat();
+	RX_FAILSAFE_LEVEL_TIME		= stream.ReadFloat();
+	RX_FAILSAFE_DESCEND_TIME	= stream.ReadFloat();
+	RX_FAILSAFE_THROTTLE		= stream.ReadFloat();
+
 	/*
 	 * Motion sensor
 	 */
@@ -197,6 +331,11 @@ bool Config::Deserialize(BinaryReadStream& stream)
 	MS_ACCEL_CORRECTION_RC 		= stream.ReadFloat();
 	MS_ACCEL_MAX 				= stream.ReadFloat();
 
+	/*
+	 * Barometer
+	 */
+	BR_ESTIMATOR_TC 			= stream.ReadFloat();
+
 	/*
 	 * Flight system
 	 */
@@ -206,18 +345,53 @@ bool Config::Deserialize(BinaryReadStream& stream)
 	FS_ATTI_MAX_PITCH 			= stream.ReadFloat();
 	FS_ATTI_MAX_ROLL			= stream.ReadFloat();
 
+	FS_RATE_MAX.Deserialize(stream);
+	FS_RATE_EXPO				= stream.ReadFloat();
+	FS_HORIZON_TRANSITION		= stream.ReadFloat();
+	FS_HORIZON_LEVEL_GAIN		= stream.ReadFloat();
+	FS_TRANSITION_TIME			= stream.ReadFloat();
+	FS_ALT_MAX_CLIMB_RATE		= stream.ReadFloat();
+	FS_ALT_PID_CONFIGURATION.Deserialize(stream);
+
 	/*
 	 * Motor controller
 	 */
-	MC_PWM_FREQUENCY 			= stream.ReadUInt32();
-	MC_PWM_PERIOD 				= stream.ReadUInt16();
+	MC_MIXER_LAYOUT 			= stream.ReadByte();
+	MC_MIXER_MODE 				= stream.ReadByte();
+	MC_OUTPUT_PROTOCOL 			= stream.ReadByte();
 	MC_PWM_MIN_COMMAND 			= stream.ReadUInt16();
 	MC_PWM_MIN_OUTPUT 			= stream.ReadUInt16();
 	MC_PWM_MAX_COMMAND 			= stream.ReadUInt16();
+	MC_THRUST_LINEARIZATION 	= stream.ReadFloat();
+	MC_THROTTLE_MID 			= stream.ReadFloat();
+	MC_THROTTLE_EXPO 			= stream.ReadFloat();
 
 	for (uint8_t axis = 0; axis < 3; ++axis)
 		MC_PID_CONFIGURATION[axis].Deserialize(stream);
 
+	for (uint8_t axis = 0; axis < 3; ++axis)
+		MC_RATE_PID_CONFIGURATION[axis].Deserialize(stream);
+
+	for (uint8_t breakpoint = 0; breakpoint < Constants::MC_GAIN_BREAKPOINTS; ++breakpoint)
+		MC_GAIN_SCHEDULE[breakpoint].Deserialize(stream);
+
+	MC_TPA_BREAKPOINT 			= stream.ReadFloat();
+	MC_TPA_RATE 				= stream.ReadFloat();
+
+	/*
+	 * Aux control
+	 */
+	for (uint8_t function = 0; function < Constants::AC_MAX_CONTROL_FUNCTIONS; ++function)
+		AC_CONTROL_FUNCTIONS[function].Deserialize(stream);
+
+	/*
+	 * Stick commands
+	 */
+	for (uint8_t command = 0; command < Constants::SC_MAX_COMMANDS; ++command)
+		SC_COMMANDS[command].Deserialize(stream);
+
+	++revision;
+
 	return true;
 }
 
@@ -238,8 +412,31 @@ uint32_t Config::SerializedSize() const
 		 */
 		sizeof(uint32_t) + // SR_BAUD_RATE;
 
+		sizeof(float) + // SR_TELEMETRY_SHARE;
+
+		sizeof(uint8_t) + // SR_USB_ENABLED;
+
+		/*
+		 * Radio receiver
+		 */
+		sizeof(uint8_t) + // RX_RECEIVER_TYPE;
+
 		ChannelCalibration::Size() * Constants::RX_MAX_CHANNELS + // RX_CHANNEL_CALIBRATION[Constants.RX_MAX_CHANNELS];
 
+		ChannelMapping::Size() * Constants::RX_MAX_CHANNELS + // RX_CHANNEL_MAPPING[Constants.RX_MAX_CHANNELS];
+
+		sizeof(uint16_t) + // RX_PULSE_MARGIN;
+
+		sizeof(uint8_t) + // RX_SMOOTHING;
+
+		sizeof(float) + // RX_FAILSAFE_HOLD_TIME;
+
+		sizeof(float) + // RX_FAILSAFE_LEVEL_TIME;
+
+		sizeof(float) + // RX_FAILSAFE_DESCEND_TIME;
+
+		sizeof(float) + // RX_FAILSAFE_THROTTLE;
+
 		/*
 		 * Motion sensor
 		 */
@@ -255,6 +452,11 @@ uint32_t Config::SerializedSize() const
 
 		sizeof(float) + // MS_ACCEL_MAX;
 
+		/*
+		 * Barometer
+		 */
+		sizeof(float) + // BR_ESTIMATOR_TC;
+
 		/*
 		 * Flight system
 		 */
@@ -265,12 +467,28 @@ uint32_t Config::SerializedSize() const
 
 		sizeof(float) + // FS_ATTI_MAX_ROLL;
 
+		Vector3::Size() + // FS_RATE_MAX;
+
+		sizeof(float) + // FS_RATE_EXPO;
+
+		sizeof(float) + // FS_HORIZON_TRANSITION;
+
+		sizeof(float) + // FS_HORIZON_LEVEL_GAIN;
+
+		sizeof(float) + // FS_TRANSITION_TIME;
+
+		sizeof(float) + // FS_ALT_MAX_CLIMB_RATE;
+
+		PidConfiguration::Size() + // FS_ALT_PID_CONFIGURATION;
+
 		/*
 		 * Motor controller
 		 */
-		sizeof(uint32_t) + // MC_PWM_FREQUENCY;
+		sizeof(uint8_t) + // MC_MIXER_LAYOUT;
+
+		sizeof(uint8_t) + // MC_MIXER_MODE;
 
-		sizeof(uint16_t) + // MC_PWM_PERIOD;
+		sizeof(uint8_t) + // MC_OUTPUT_PROTOCOL;
 
 		sizeof(uint16_t) + // MC_PWM_MIN_COMMAND;
 
@@ -278,10 +496,48 @@ uint32_t Config::SerializedSize() const
 
 		sizeof(uint16_t) + // MC_PWM_MAX_COMMAND;
 
+		sizeof(float) + // MC_THRUST_LINEARIZATION;
+
+		sizeof(float) + // MC_THROTTLE_MID;
+
+		sizeof(float) + // MC_THROTTLE_EXPO;
+
 		PidConfiguration::Size() * 3 + // MC_PID_CONFIGURATION[3];
+
+		PidConfiguration::Size() * 3 + // MC_RATE_PID_CONFIGURATION[3];
+
+		PidConfiguration::Size() * Constants::MC_GAIN_BREAKPOINTS + // MC_GAIN_SCHEDULE[Constants::MC_GAIN_BREAKPOINTS];
+
+		sizeof(float) + // MC_TPA_BREAKPOINT;
+
+		sizeof(float) + // MC_TPA_RATE;
+
+		/*
+		 * Aux control
+		 */
+		SwitchRule::Size() * Constants::AC_MAX_CONTROL_FUNCTIONS + // AC_CONTROL_FUNCTIONS[Constants.AC_MAX_CONTROL_FUNCTIONS];
+
+		/*
+		 * Stick commands
+		 */
+		SwitchRule::Size() * Constants::SC_MAX_COMMANDS + // SC_COMMANDS[Constants.SC_MAX_COMMANDS];
 	0;
 }
 
+void Config::SetPidConfiguration(uint8_t axis, const PidConfiguration& configuration)
+{
+	MC_PID_CONFIGURATION[axis] = configuration;
+
+	++revision;
+}
+
+void Config::SetRatePidConfiguration(uint8_t axis, const PidConfiguration& configuration)
+{
+	MC_RATE_PID_CONFIGURATION[axis] = configuration;
+
+	++revision;
+}
+
 bool Config::HandleCommand(Command::RequestMessage& command)
 {
 	switch (command.type)
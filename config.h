@@ -29,7 +29,9 @@ public:
 			I2C_SDA			= 20,
 			I2C_SCL			= 21,
 
-			RX_PWM			= 48
+			RX_PWM			= 48,
+			RX_PPM			= 2,
+			RX_SERIAL		= 19
 		};
 	};
 
@@ -45,7 +47,10 @@ public:
 		/*
 		 * Motor controller
 		 */
-		static const uint8_t MC_MOTOR_AMOUNT = 4;
+		static const uint8_t MC_MAX_MOTORS = 8;
+
+		// Amount of evenly spaced throttle points in the gain schedule, the first one being zero throttle and the last one full throttle
+		static const uint8_t MC_GAIN_BREAKPOINTS = 5;
 
 		/**
 		 * Aux control
@@ -102,6 +107,148 @@ public:
 		}
 	};
 
+	// Where a receiver channel is read from, and how its stick input is shaped
+	struct ChannelMapping : public Serializable, public Deserializable
+	{
+		// Input channel of the receiver
+		uint8_t source;
+
+		uint8_t reverse;
+
+		// Scale and expo applied to the normalized channel
+		float rate, expo;
+
+		ChannelMapping() : source(0), reverse(0), rate(1.0f), expo(0.0f)
+		{
+
+		}
+
+		ChannelMapping(uint8_t source) : source(source), reverse(0), rate(1.0f), expo(0.0f)
+		{
+
+		}
+
+		virtual void Serialize(BinaryWriteStream& stream) const
+		{
+			stream.Write(source);
+			stream.Write(reverse);
+			stream.Write(rate);
+			stream.Write(expo);
+		}
+
+		virtual bool Deserialize(BinaryReadStream& stream)
+		{
+			source = stream.ReadByte();
+			reverse = stream.ReadByte();
+			rate = stream.ReadFloat();
+			expo = stream.ReadFloat();
+
+			return true;
+		}
+
+		__inline virtual uint32_t SerializedSize() const
+		{
+			return ChannelMapping::Size();
+		}
+
+		static uint32_t Size()
+		{
+			return sizeof(uint8_t) * 2 + sizeof(float) * 2;
+		}
+	};
+
+	// Rule that activates an action while receiver channels are within their ranges, used by aux functions and stick commands
+	struct SwitchRule : public Serializable, public Deserializable
+	{
+		static const uint8_t CONDITIONS = 4;
+
+		static const uint8_t NO_CHANNEL = 0xFF;
+
+		// Action of the module evaluating the rule, zero for an unused rule
+		uint8_t action;
+
+		// Normalized range each channel needs to be in, unused conditions have NO_CHANNEL
+		uint8_t channels[CONDITIONS];
+		float min[CONDITIONS], max[CONDITIONS];
+
+		// Amount the ranges widen by once the rule is active
+		float hysteresis;
+
+		// Time (ms) the channels need to stay in range before the rule activates
+		uint16_t holdTime;
+
+		SwitchRule() : action(0), hysteresis(0.0f), holdTime(0)
+		{
+			for (uint8_t condition = 0; condition < CONDITIONS; ++condition)
+			{
+				channels[condition] = NO_CHANNEL;
+				min[condition] = 0.0f;
+				max[condition] = 0.0f;
+			}
+		}
+
+		SwitchRule(uint8_t action, float hysteresis, uint16_t holdTime) : action(action), hysteresis(hysteresis), holdTime(holdTime)
+		{
+			for (uint8_t condition = 0; condition < CONDITIONS; ++condition)
+			{
+				channels[condition] = NO_CHANNEL;
+				min[condition] = 0.0f;
+				max[condition] = 0.0f;
+			}
+		}
+
+		SwitchRule& SetCondition(uint8_t condition, uint8_t channel, float min, float max)
+		{
+			this->channels[condition] = channel;
+			this->min[condition] = min;
+			this->max[condition] = max;
+
+			return *this;
+		}
+
+		virtual void Serialize(BinaryWriteStream& stream) const
+		{
+			stream.Write(action);
+
+			for (uint8_t condition = 0; condition < CONDITIONS; ++condition)
+			{
+				stream.Write(channels[condition]);
+				stream.Write(min[condition]);
+				stream.Write(max[condition]);
+			}
+
+			stream.Write(hysteresis);
+			stream.Write(holdTime);
+		}
+
+		virtual bool Deserialize(BinaryReadStream& stream)
+		{
+			action = stream.ReadByte();
+
+			for (uint8_t condition = 0; condition < CONDITIONS; ++condition)
+			{
+				channels[condition] = stream.ReadByte();
+				min[condition] = stream.ReadFloat();
+				max[condition] = stream.ReadFloat();
+			}
+
+			hysteresis = stream.ReadFloat();
+			holdTime = stream.ReadUInt16();
+
+			return true;
+		}
+
+		__inline virtual uint32_t SerializedSize() const
+		{
+			return SwitchRule::Size();
+		}
+
+		static uint32_t Size()
+		{
+			return sizeof(uint8_t) + (sizeof(uint8_t) + sizeof(float) * 2) * CONDITIONS + sizeof(float) + sizeof(uint16_t);
+		}
+	};
+
 	struct PidConfiguration : public Serializable, public Deserializable
 	{
 		float kp, ki, kd;
@@ -146,7 +293,7 @@ public:
 
 	static const uint32_t CONFIG_MAGIC = 0xDEADBEEF;
 
-	static const uint16_t LATEST_VERSION = 0x01;
+	static const uint16_t LATEST_VERSION = 0x11;
 
 	/*
 	 * Config management
@@ -165,8 +312,31 @@ public:
 	 */
 	uint32_t SR_BAUD_RATE;
 
+	float SR_TELEMETRY_SHARE;
+
+	uint8_t SR_USB_ENABLED;
+
+	/*
+	 * Radio receiver
+	 */
+	uint8_t RX_RECEIVER_TYPE;
+
 	ChannelCalibration RX_CHANNEL_CALIBRATION[Constants::RX_MAX_CHANNELS];
 
+	ChannelMapping RX_CHANNEL_MAPPING[Constants::RX_MAX_CHANNELS];
+
+	uint16_t RX_PULSE_MARGIN;
+
+	uint8_t RX_SMOOTHING;
+
+	float RX_FAILSAFE_HOLD_TIME;
+
+	float RX_FAILSAFE_LEVEL_TIME;
+
+	float RX_FAILSAFE_DESCEND_TIME;
+
+	float RX_FAILSAFE_THROTTLE;
+
 	/*
 	 * Motion sensor
 	 */
@@ -182,6 +352,11 @@ public:
 
 	float MS_ACCEL_MAX;
 
+	/*
+	 * Barometer
+	 */
+	float BR_ESTIMATOR_TC;
+
 	/*
 	 * Flight system
 	 */
@@ -192,12 +367,28 @@ public:
 
 	float FS_ATTI_MAX_ROLL;
 
+	Vector3 FS_RATE_MAX;
+
+	float FS_RATE_EXPO;
+
+	float FS_HORIZON_TRANSITION;
+
+	float FS_HORIZON_LEVEL_GAIN;
+
+	float FS_TRANSITION_TIME;
+
+	float FS_ALT_MAX_CLIMB_RATE;
+
+	PidConfiguration FS_ALT_PID_CONFIGURATION;
+
 	/*
 	 * Motor controller
 	 */
-	uint32_t MC_PWM_FREQUENCY;
+	uint8_t MC_MIXER_LAYOUT;
+
+	uint8_t MC_MIXER_MODE;
 
-	uint16_t MC_PWM_PERIOD;
+	uint8_t MC_OUTPUT_PROTOCOL;
 
 	uint16_t MC_PWM_MIN_COMMAND;
 
@@ -205,8 +396,32 @@ public:
 
 	uint16_t MC_PWM_MAX_COMMAND;
 
+	float MC_THRUST_LINEARIZATION;
+
+	float MC_THROTTLE_MID;
+
+	float MC_THROTTLE_EXPO;
+
 	PidConfiguration MC_PID_CONFIGURATION[3];
 
+	PidConfiguration MC_RATE_PID_CONFIGURATION[3];
+
+	PidConfiguration MC_GAIN_SCHEDULE[Constants::MC_GAIN_BREAKPOINTS];
+
+	float MC_TPA_BREAKPOINT;
+
+	float MC_TPA_RATE;
+
+	/*
+	 * Aux control
+	 */
+	SwitchRule AC_CONTROL_FUNCTIONS[Constants::AC_MAX_CONTROL_FUNCTIONS];
+
+	/*
+	 * Stick commands
+	 */
+	SwitchRule SC_COMMANDS[Constants::SC_MAX_COMMANDS];
+
 private:
 	uint8_t* buffer;
 
@@ -214,6 +429,9 @@ private:
 
 	MemoryStream bufferStream;
 
+	// Incremented every time the values are changed, so that modules know when to update values they derive from the config
+	uint32_t revision;
+
 private:
 	Config();
 
@@ -236,6 +454,12 @@ public:
 
 	virtual bool HandleCommand(Command::RequestMessage& command);
 
+	uint32_t Revision() const { return revision; }
+
+	// Changes the PID configuration of an axis in memory, it is only persisted when the host saves the config
+	void SetPidConfiguration(uint8_t axis, const PidConfiguration& configuration);
+	void SetRatePidConfiguration(uint8_t axis, const PidConfiguration& configuration);
+
 private:
 	
 	bool ReadConfig(Command::RequestMessage& command);
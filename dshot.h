@@ -0,0 +1,70 @@
+#ifndef _DSHOT_H_
+#define _DSHOT_H_
+
+#include <stdint.h>
+
+namespace bothezat
+{
+
+/*
+ *	Encoding of DShot digital ESC frames. Has no hardware dependencies so it can also be compiled on a host.
+ *
+ *	A frame consists of 16 bits, sent MSB first:
+ *		11 bits		throttle value (48 ... 2047) or special command (0 ... 47)
+ *		 1 bit		telemetry request
+ *		 4 bits		checksum
+ */
+struct Dshot
+{
+	static const uint8_t FRAME_BITS = 16;
+
+	// Special command which stops the motor
+	static const uint16_t MOTOR_STOP = 0;
+
+	static const uint16_t MIN_THROTTLE = 48;
+	static const uint16_t MAX_THROTTLE = 2047;
+
+	// Converts an output in the 0 ... 1 range to a throttle value
+	static uint16_t ThrottleValue(float output)
+	{
+		if (output <= 0.0f)
+			return MIN_THROTTLE;
+
+		if (output >= 1.0f)
+			return MAX_THROTTLE;
+
+		return MIN_THROTTLE + static_cast<uint16_t>(output * (MAX_THROTTLE - MIN_THROTTLE) + 0.5f);
+	}
+
+	// Calculates the checksum over the 12 data bits of a frame
+	static uint16_t Checksum(uint16_t packet)
+	{
+		return (packet ^ (packet >> 4) ^ (packet >> 8)) & 0x0F;
+	}
+
+	static uint16_t EncodeFrame(uint16_t value, bool telemetry = false)
+	{
+		uint16_t packet = (value << 1) | (telemetry ? 1 : 0);
+
+		return (packet << 4) | Checksum(packet);
+	}
+
+	// Writes a value for each bit of the frame to the buffer, MSB first.
+	// Consecutive bits are written stride elements apart so that frames for multiple outputs can be interleaved
+	template<typename T>
+	static void EncodeBits(uint16_t frame, T* buffer, uint32_t stride, T one, T zero)
+	{
+		for (uint8_t bit = 0; bit < FRAME_BITS; ++bit)
+		{
+			*buffer = (frame & 0x8000) ? one : zero;
+
+			frame <<= 1;
+			buffer += stride;
+		}
+	}
+
+};
+
+}
+
+#endif
@@ -5,12 +5,17 @@
 
 #include "receiver.h"
 #include "motion_sensor.h"
+#include "barometer.h"
+#include "motor_controller.h"
 
 namespace bothezat
 {
 
 
-// Base class for flight modes
+/*
+ *	Base class for flight modes. Modes are not called through virtual functions, but through the FlightModeList
+ *	at the bottom of this file. Functions of the base class that are hidden by a mode are called instead of the base version.
+ */
 class FlightMode
 {
 public:
@@ -19,16 +24,35 @@ public:
 	{
 		MANUAL = 0,
 		ANGLE,
+		RATE,
+		HORIZON,
+		ALTITUDE_HOLD,
 
 		LAST_FLIGHT_MODE
 	};
 
+	// Which setpoint the motor controller should follow
+	enum Control
+	{
+		CONTROL_ANGLE = 0,
+		CONTROL_RATE
+	};
+
 private:
 	ID id;
 
+	Control control;
+
 	Quaternion desiredOrientation;
 	Rotation desiredRotation;
 
+	// Desired angular velocity in degrees per second
+	Rotation desiredAngularVelocity;
+
+	// Whether the mode sets the throttle instead of the throttle stick
+	bool throttleControl;
+	float desiredThrottle;
+
 protected:
 	Receiver* receiver;
 
@@ -37,8 +61,9 @@ protected:
 	Config& config;
 
 protected:
-	FlightMode(ID id) : 
-		id(id), desiredOrientation(),
+	FlightMode(ID id, Control control = CONTROL_ANGLE, bool throttleControl = false) : 
+		id(id), control(control), desiredOrientation(), desiredRotation(), desiredAngularVelocity(),
+		throttleControl(throttleControl), desiredThrottle(0.0f),
 		receiver(NULL), motionSensor(NULL), config(Config::Instance())
 	{
 
@@ -50,33 +75,57 @@ protected:
 		desiredOrientation.ToEulerAngles(desiredRotation);
 	}
 
+	void SetDesiredAngularVelocity(const Rotation& desiredAngularVelocity)
+	{
+		this->desiredAngularVelocity = desiredAngularVelocity;
+	}
+
+	void SetDesiredThrottle(float desiredThrottle)
+	{
+		this->desiredThrottle = desiredThrottle;
+	}
+
+	// Applies expo to the stick position and scales it to the max rate
+	float StickRate(float stick, float maxRate) const
+	{
+		float expo = config.FS_RATE_EXPO;
+
+		return stick * (1.0f - expo + expo * stick * stick) * maxRate;
+	}
+
 public:
-	virtual void Setup()
+	void Setup()
 	{
 		receiver = &Receiver::CurrentReceiver();
 		motionSensor = &MotionSensor::Instance();
 	};
 
-	virtual void Loop(uint32_t dt)
+	void Loop(uint32_t dt)
 	{
 
 	};
 
-	virtual void OnEnter() 
+	void OnEnter() 
 	{
 		SetDesiredOrientation(motionSensor->CurrentOrientation());
 	};
 
-	virtual void OnExit()
+	void OnExit()
 	{
 
 
 	};
 
-	virtual const char* Name() = 0;
-
 	const Quaternion& DesiredOrientation() const { return desiredOrientation; }
 	const Rotation& DesiredRotation() const { return desiredRotation; }
+	const Rotation& DesiredAngularVelocity() const { return desiredAngularVelocity; }
+
+	Control ControlType() const { return control; }
+
+	bool ControlsThrottle() const { return throttleControl; }
+
+	// Throttle in the 0 ... 1 range, only used if the mode controls the throttle
+	float DesiredThrottle() const { return desiredThrottle; }
 };
 
 // Sticks control angular velocity
@@ -87,17 +136,19 @@ private:
 	Quaternion setOrientation;
 
 public:
-	ManualMode() : FlightMode(MANUAL)
+	static const ID MODE_ID = MANUAL;
+
+	ManualMode() : FlightMode(MODE_ID)
 	{
 
 	}
 
-	virtual void Setup()
+	void Setup()
 	{
 		FlightMode::Setup();
 	}
 
-	virtual void Loop(uint32_t dt)
+	void Loop(uint32_t dt)
 	{
 		FlightMode::Loop(dt);
 
@@ -120,7 +171,7 @@ public:
 		SetDesiredOrientation(setOrientation);
 	}
 
-	virtual const char* Name() { return "Manual"; }
+	const char* Name() const { return "Manual"; }
 
 };
 
@@ -129,17 +180,26 @@ class AngleMode : public FlightMode
 {
 
 public:
-	AngleMode() : FlightMode(ANGLE)
+	static const ID MODE_ID = ANGLE;
+
+	AngleMode() : FlightMode(MODE_ID)
+	{
+
+	}
+
+protected:
+	AngleMode(ID id, bool throttleControl) : FlightMode(id, CONTROL_ANGLE, throttleControl)
 	{
 
 	}
 
-	virtual void Setup()
+public:
+	void Setup()
 	{
 		FlightMode::Setup();
 	}
 
-	virtual void Loop(uint32_t dt)
+	void Loop(uint32_t dt)
 	{ 
 		FlightMode::Loop(dt);
 
@@ -157,10 +217,301 @@ public:
 		SetDesiredOrientation(orientation);
 	}
 
-	virtual const char* Name() { return "Angle"; }
+	const char* Name() const { return "Angle"; }
+
+};
+
+// Sticks control angular velocity, which is followed directly by the rate controllers
+class RateMode : public FlightMode
+{
+
+public:
+	static const ID MODE_ID = RATE;
+
+	RateMode() : FlightMode(MODE_ID, CONTROL_RATE)
+	{
+
+	}
+
+	void Setup()
+	{
+		FlightMode::Setup();
+	}
+
+	void Loop(uint32_t dt)
+	{
+		FlightMode::Loop(dt);
+
+		Rotation rate;
+		rate.yaw = StickRate(receiver->NormalizedChannel(Receiver::RUDDER), config.FS_RATE_MAX.yaw);
+		rate.pitch = StickRate(receiver->NormalizedChannel(Receiver::ELEVATOR), config.FS_RATE_MAX.pitch);
+		rate.roll = StickRate(receiver->NormalizedChannel(Receiver::AILERON), config.FS_RATE_MAX.roll);
+
+		SetDesiredAngularVelocity(rate);
+	}
+
+	const char* Name() const { return "Rate"; }
+
+};
+
+// Self-levels like angle mode around center stick and blends into rate mode towards full stick deflection
+class HorizonMode : public FlightMode
+{
+
+private:
+	uint32_t frameID;
+
+	// Stick derived values, only updated when the receiver channels change
+	Rotation stickRate, stickAngle;
+	float levelStrength;
+
+public:
+	static const ID MODE_ID = HORIZON;
+
+	HorizonMode() : FlightMode(MODE_ID, CONTROL_RATE), frameID(0), stickRate(), stickAngle(), levelStrength(0.0f)
+	{
+
+	}
+
+	void Setup()
+	{
+		FlightMode::Setup();
+	}
+
+	void OnEnter()
+	{
+		FlightMode::OnEnter();
+
+		// Make sure the stick values are up to date in the first loop
+		frameID = receiver->FrameID() - 1;
+	}
+
+	void Loop(uint32_t dt)
+	{
+		FlightMode::Loop(dt);
+
+		// Smoothed channels change between frames as well
+		if (receiver->FrameID() != frameID || receiver->IsSmoothing())
+		{
+			frameID = receiver->FrameID();
+			UpdateSticks();
+		}
+
+		Rotation rate = stickRate;
+
+		// Steer towards the angle the sticks would select in angle mode, weighed by how close the sticks are to center
+		if (levelStrength > 0.0f)
+		{
+			Rotation rotation;
+			motionSensor->CurrentOrientation().ToEulerAngles(rotation);
+
+			float gain = levelStrength * config.FS_HORIZON_LEVEL_GAIN;
+			rate.pitch += (stickAngle.pitch - rotation.pitch) * gain;
+			rate.roll += (stickAngle.roll - rotation.roll) * gain;
+		}
+
+		SetDesiredAngularVelocity(rate);
+	}
+
+	const char* Name() const { return "Horizon"; }
+
+private:
+	void UpdateSticks()
+	{
+		float pitch = receiver->NormalizedChannel(Receiver::ELEVATOR);
+		float roll = receiver->NormalizedChannel(Receiver::AILERON);
+		float yaw = receiver->NormalizedChannel(Receiver::RUDDER);
+
+		stickRate.yaw = StickRate(yaw, config.FS_RATE_MAX.yaw);
+		stickRate.pitch = StickRate(pitch, config.FS_RATE_MAX.pitch);
+		stickRate.roll = StickRate(roll, config.FS_RATE_MAX.roll);
+
+		stickAngle.pitch = pitch * config.FS_ATTI_MAX_PITCH;
+		stickAngle.roll = roll * config.FS_ATTI_MAX_ROLL;
+
+		// Self-levelling fades out linearly until the transition deflection is reached
+		float deflection = max(fabs(pitch), fabs(roll));
+
+		if (deflection >= config.FS_HORIZON_TRANSITION)
+			levelStrength = 0.0f;
+		else
+			levelStrength = 1.0f - deflection / config.FS_HORIZON_TRANSITION;
+	}
+
+};
+
+// Levels like angle mode and holds altitude with the barometer, throttle stick deflection from the hover position controls the climb rate
+class AltitudeHoldMode : public AngleMode
+{
+
+private:
+	// Throttle stick travel around the hover position (normalized) that holds the altitude
+	static const float CLIMB_DEADBAND = 0.1f;
+
+	Barometer* barometer;
+	MotorController* motorController;
+
+	MotorController::PidController altitudeController;
+
+	float targetAltitude;
+
+	// Throttle when the mode was entered, the altitude controller corrects around this
+	float hoverThrottle;
+
+	// Normalized throttle stick position when the mode was entered, climb is measured from here
+	float hoverStick;
+
+public:
+	static const ID MODE_ID = ALTITUDE_HOLD;
+
+	AltitudeHoldMode() : AngleMode(MODE_ID, true), barometer(NULL), motorController(NULL), targetAltitude(0.0f), hoverThrottle(0.0f), hoverStick(0.0f)
+	{
+
+	}
+
+	void Setup()
+	{
+		AngleMode::Setup();
+
+		barometer = &Barometer::Instance();
+		motorController = &MotorController::Instance();
+	}
+
+	void OnEnter()
+	{
+		AngleMode::OnEnter();
+
+		altitudeController.Configure(config.FS_ALT_PID_CONFIGURATION);
+		altitudeController.Reset();
+		altitudeController.lastInput = barometer->Altitude();
+
+		// Hold the current altitude with the current throttle
+		targetAltitude = barometer->Altitude();
+		hoverThrottle = motorController->StickThrottle();
+		hoverStick = ThrottleStick();
+
+		SetDesiredThrottle(hoverThrottle);
+	}
+
+	void Loop(uint32_t dt)
+	{
+		AngleMode::Loop(dt);
+
+		// Without a barometer the throttle stick is passed through
+		if (!barometer->IsAvailable())
+		{
+			SetDesiredThrottle(motorController->StickThrottle());
+			return;
+		}
+
+		float deltaSeconds = dt * 1e-6f;
+
+		float climb = ClimbInput();
+		targetAltitude += climb * config.FS_ALT_MAX_CLIMB_RATE * deltaSeconds;
+
+		altitudeController.target = targetAltitude;
+		altitudeController.Update(barometer->Altitude(), deltaSeconds);
+
+		float throttle = hoverThrottle + altitudeController.output;
+		SetDesiredThrottle(throttle < 0.0f ? 0.0f : (throttle > 1.0f ? 1.0f : throttle));
+	}
+
+	const char* Name() const { return "Altitude hold"; }
+
+private:
+	// Requested climb rate (-1 ... 1), the stick travel outside the deadband on either side of the hover position scales to the full rate
+	float ClimbInput() const
+	{
+		float deflection = ThrottleStick() - hoverStick;
 
+		if (fabs(deflection) <= CLIMB_DEADBAND)
+			return 0.0f;
+
+		float travel = (deflection > 0.0f ? 1.0f - hoverStick : 1.0f + hoverStick) - CLIMB_DEADBAND;
+		float climb = (fabs(deflection) - CLIMB_DEADBAND) / travel;
+
+		return deflection > 0.0f ? min(climb, 1.0f) : -min(climb, 1.0f);
+	}
+
+	// Rate scaling can take the normalized channel past the end points, the climb range is measured within them
+	float ThrottleStick() const
+	{
+		return Util::Clamp(receiver->NormalizedChannel(Receiver::THROTTLE), -1.0f, 1.0f);
+	}
+
+};
+
+/*
+ *	Compile time list of flight modes. Each entry holds its mode by value, so the storage of all modes is known at link time.
+ *	Calls are dispatched by comparing the ID against the MODE_ID of each entry, which the compiler can flatten and inline.
+ */
+struct ModeListEnd
+{
+	void Setup() { }
+
+	void Loop(FlightMode::ID id, uint32_t dt) { }
+
+	void OnEnter(FlightMode::ID id) { }
+	void OnExit(FlightMode::ID id) { }
+
+	const char* Name(FlightMode::ID id) const { return "Unknown"; }
+
+	FlightMode* Find(FlightMode::ID id) { return NULL; }
+};
+
+template <class Mode, class Next = ModeListEnd>
+struct ModeList
+{
+	Mode mode;
+	Next next;
+
+	void Setup()
+	{
+		mode.Setup();
+		next.Setup();
+	}
+
+	void Loop(FlightMode::ID id, uint32_t dt)
+	{
+		if (id == Mode::MODE_ID)
+			mode.Loop(dt);
+		else
+			next.Loop(id, dt);
+	}
+
+	void OnEnter(FlightMode::ID id)
+	{
+		if (id == Mode::MODE_ID)
+			mode.OnEnter();
+		else
+			next.OnEnter(id);
+	}
+
+	void OnExit(FlightMode::ID id)
+	{
+		if (id == Mode::MODE_ID)
+			mode.OnExit();
+		else
+			next.OnExit(id);
+	}
+
+	const char* Name(FlightMode::ID id) const
+	{
+		return id == Mode::MODE_ID ? mode.Name() : next.Name(id);
+	}
+
+	FlightMode* Find(FlightMode::ID id)
+	{
+		return id == Mode::MODE_ID ? &mode : next.Find(id);
+	}
 };
 
+// All available flight modes, new modes need to be added here and to FlightMode::ID
+typedef ModeList<ManualMode,
+		ModeList<AngleMode,
+		ModeList<RateMode,
+		ModeList<HorizonMode,
+		ModeList<AltitudeHoldMode> > > > > FlightModeList;
 
 }
 
@@ -3,21 +3,21 @@
 
 using namespace bothezat;
 
-FlightSystem::FlightSystem()
+FlightSystem::FlightSystem() : currentModeBase(NULL), motionSensor(NULL), receiver(NULL), failsafeActive(false), failsafeYaw(0.0f)
 {
 
 }
 
 void FlightSystem::Setup()
 {
-	flightModes[FlightMode::MANUAL]		= new ManualMode();
-	flightModes[FlightMode::ANGLE]		= new AngleMode();
+	flightModes.Setup();
 
-	for (uint8_t modeIdx = 0; modeIdx < FlightMode::LAST_FLIGHT_MODE; ++modeIdx)
-		flightModes[modeIdx]->Setup();
+	motionSensor = &MotionSensor::Instance();
+	receiver = &Receiver::CurrentReceiver();
 
 	currentMode = DEFAULT_MODE;
-	CurrentMode().OnEnter();
+	currentModeBase = flightModes.Find(currentMode);
+	flightModes.OnEnter(currentMode);
 }
 
 void FlightSystem::Debug() const
@@ -31,7 +31,93 @@ void FlightSystem::Debug() const
 
 void FlightSystem::Loop(uint32_t dt)
 {
-	CurrentMode().Loop(dt);
+	flightModes.Loop(currentMode, dt);
+
+	bool failsafe = receiver->Failsafe() >= Receiver::FAILSAFE_LEVEL;
+
+	if (failsafe != failsafeActive)
+	{
+		failsafeActive = failsafe;
+
+		if (failsafeActive)
+		{
+			// Keep the current heading while levelling
+			Rotation rotation;
+			motionSensor->CurrentOrientation().ToEulerAngles(rotation);
+			failsafeYaw = rotation.yaw;
+
+			Debug::Print("Failsafe took over the flight mode\n");
+		}
+
+		StartTransition(failsafeActive ? FlightMode::CONTROL_ANGLE : CurrentMode().ControlType());
+	}
+
+	UpdateSetpoint(dt * 1e-6f);
+}
+
+void FlightSystem::UpdateSetpoint(float deltaSeconds)
+{
+	const FlightMode& mode = CurrentMode();
+
+	setpoint.control = mode.ControlType();
+	setpoint.rotation = mode.DesiredRotation();
+	setpoint.angularVelocity = mode.DesiredAngularVelocity();
+	setpoint.throttleControl = mode.ControlsThrottle();
+	setpoint.throttle = mode.DesiredThrottle();
+
+	if (failsafeActive)
+		ApplyFailsafe();
+
+	if (!transition.active)
+		return;
+
+	transition.elapsed += deltaSeconds;
+
+	if (transition.elapsed >= transition.duration)
+	{
+		transition.active = false;
+		return;
+	}
+
+	float t = transition.elapsed / transition.duration;
+
+	if (setpoint.control == FlightMode::CONTROL_RATE)
+		setpoint.angularVelocity = Vector3::Lerp(transition.from.angularVelocity, setpoint.angularVelocity, t);
+	else
+	{
+		for (uint8_t axis = 0; axis < 3; ++axis)
+			setpoint.rotation[axis] = LerpAngle(transition.from.rotation[axis], setpoint.rotation[axis], t);
+	}
+}
+
+void FlightSystem::ApplyFailsafe()
+{
+	setpoint.control = FlightMode::CONTROL_ANGLE;
+	setpoint.rotation.yaw = failsafeYaw;
+	setpoint.rotation.pitch = 0.0f;
+	setpoint.rotation.roll = 0.0f;
+	setpoint.throttleControl = true;
+
+	switch (receiver->Failsafe())
+	{
+		case Receiver::FAILSAFE_LEVEL:
+			setpoint.throttle = config.RX_FAILSAFE_THROTTLE;
+			break;
+
+		case Receiver::FAILSAFE_DESCEND:
+		{
+			// Ramp the throttle down over the descend time
+			float descendTime = receiver->LinkLostTime() * 1e-6f - config.RX_FAILSAFE_HOLD_TIME - config.RX_FAILSAFE_LEVEL_TIME;
+			float t = config.RX_FAILSAFE_DESCEND_TIME > 0.0f ? descendTime / config.RX_FAILSAFE_DESCEND_TIME : 1.0f;
+
+			setpoint.throttle = config.RX_FAILSAFE_THROTTLE * (1.0f - constrain(t, 0.0f, 1.0f));
+			break;
+		}
+
+		default:
+			setpoint.throttle = 0.0f;
+			break;
+	}
 }
 
 void FlightSystem::SwitchMode(FlightMode::ID id)
@@ -39,11 +125,54 @@ void FlightSystem::SwitchMode(FlightMode::ID id)
 	if (id == currentMode)
 		return;
 
-	CurrentMode().OnExit();
+	FlightMode* mode = flightModes.Find(id);
+
+	if (mode == NULL)
+		return;
+
+	flightModes.OnExit(currentMode);
 
 	currentMode = id;
+	currentModeBase = mode;
+
+	flightModes.OnEnter(currentMode);
+
+	// While the failsafe is active it keeps overriding the new mode
+	StartTransition(failsafeActive ? FlightMode::CONTROL_ANGLE : CurrentMode().ControlType());
+
+	Debug::Print("Switched flight mode to: %s\n", flightModes.Name(currentMode));
+}
+
+void FlightSystem::StartTransition(FlightMode::Control control)
+{
+	// Start the transition from the setpoint currently being followed. If the control type changes, 
+	// the measured state is the closest equivalent of the old setpoint in terms of the new control type
+	Setpoint& from = transition.from;
+	from = setpoint;
+	from.control = control;
+
+	if (setpoint.control != from.control)
+	{
+		if (from.control == FlightMode::CONTROL_RATE)
+			from.angularVelocity = motionSensor->RawAngularVelocity() * RAD_2_DEG;
+		else
+			motionSensor->CurrentOrientation().ToEulerAngles(from.rotation);
+	}
+
+	transition.elapsed = 0.0f;
+	transition.duration = config.FS_TRANSITION_TIME;
+	transition.active = transition.duration > 0.0f;
+}
+
+float FlightSystem::LerpAngle(float from, float to, float t)
+{
+	// Interpolate along the shortest way around the circle
+	float delta = fmod(to - from, 360.0f);
 
-	CurrentMode().OnEnter();
+	if (delta > 180.0f)
+		delta -= 360.0f;
+	else if (delta < -180.0f)
+		delta += 360.0f;
 
-	Debug::Print("Switched flight mode to: %s\n", CurrentMode().Name());
+	return from + delta * t;
 }
\ No newline at end of file
@@ -8,6 +8,8 @@
 
 namespace bothezat
 {
+
+class MotionSensor;
 	
 class FlightSystem : public Module<FlightSystem>
 {
@@ -16,11 +18,60 @@ friend class Module<FlightSystem>;
 public:
 	static const FlightMode::ID DEFAULT_MODE = FlightMode::MANUAL;
 
+	// Setpoint the motor controller follows
+	struct Setpoint
+	{
+		FlightMode::Control control;
+
+		// Desired rotation (deg) and angular velocity (deg/s), only the one matching the control type is used
+		Rotation rotation;
+		Rotation angularVelocity;
+
+		// Throttle in the 0 ... 1 range, only used if the mode controls the throttle
+		bool throttleControl;
+		float throttle;
+
+		Setpoint() : control(FlightMode::CONTROL_ANGLE), rotation(), angularVelocity(), throttleControl(false), throttle(0.0f)
+		{
+
+		}
+	};
+
+	// Interpolation from the setpoint at the moment of a mode switch to the setpoint of the new mode
+	struct Transition
+	{
+		bool active;
+
+		// Setpoint at the moment of the switch, expressed in the control type of the new mode
+		Setpoint from;
+
+		float elapsed, duration;
+
+		Transition() : active(false), from(), elapsed(0.0f), duration(0.0f)
+		{
+
+		}
+	};
+
 private:
-	FlightMode* flightModes[FlightMode::LAST_FLIGHT_MODE];
+	FlightModeList flightModes;
 
 	FlightMode::ID currentMode;
 
+	// Base of the current mode, used to access its setpoints
+	FlightMode* currentModeBase;
+
+	MotionSensor* motionSensor;
+	Receiver* receiver;
+
+	Setpoint setpoint;
+
+	// Whether the receiver failsafe overrides the setpoint, and the heading it holds meanwhile
+	bool failsafeActive;
+	float failsafeYaw;
+
+	Transition transition;
+
 protected:
 	FlightSystem();
 
@@ -32,11 +83,25 @@ public:
 
 	void SwitchMode(FlightMode::ID id);
 
-	FlightMode& CurrentMode() { return *flightModes[currentMode]; }
-	const FlightMode& CurrentMode() const { return *flightModes[currentMode]; }
+	FlightMode& CurrentMode() { return *currentModeBase; }
+	const FlightMode& CurrentMode() const { return *currentModeBase; }
 
 	FlightMode::ID CurrentModeID() { return currentMode;}
 
+	// Setpoint of the current mode, blended with the previous one while a transition is in progress
+	const Setpoint& CurrentSetpoint() const { return setpoint; }
+
+private:
+	void UpdateSetpoint(float deltaSeconds);
+
+	// Replaces the setpoint of the mode by levelling at the failsafe throttle
+	void ApplyFailsafe();
+
+	// Starts blending from the setpoint currently being followed to a setpoint of the given control type
+	void StartTransition(FlightMode::Control control);
+
+	static float LerpAngle(float from, float to, float t);
+
 };
 
 }
@@ -0,0 +1,21 @@
+#ifndef _ARDUINO_H_
+#define _ARDUINO_H_
+
+/*
+ *	Stand-in for the parts of the Arduino core that the hardware independent headers use, so they can be built on the host.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+
+// Only orders the accesses of the compiler, the host checks run on a single core
+inline void __DMB()
+{
+	__asm__ volatile ("" ::: "memory");
+}
+
+#endif
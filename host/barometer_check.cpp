@@ -0,0 +1,287 @@
+/*
+ *	Checks the MS5611 compensation and the altitude estimator against a simulated sensor on the host.
+ *
+ *	The sensor is read with the same conversion schedule as the Barometer module, while a simulated airframe climbs.
+ *	The estimator is fed both the unfiltered and the low pass filtered accelerometer, to show that the filtered one
+ *	makes the estimate lag instead of helping it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "ms5611.h"
+#include "altitude_estimator.h"
+
+#include "ms5611_sim.h"
+
+using namespace bothezat;
+
+static const float GRAVITY = 9.81f;
+
+// Loop interval (us), and the configuration of the Barometer module
+static const uint32_t DT = 1000;
+static const uint8_t OSR = MS5611_OSR_1024;
+static const uint32_t CONVERSION_TIME = MS5611_CONVERSION_1024;
+static const uint8_t TEMPERATURE_INTERVAL = 8;
+
+static const float ESTIMATOR_TC = 1.0f;
+static const float ACCEL_FILTER_RC = 2.5f;
+
+static bool Check(bool condition, const char* description)
+{
+	printf("  %s: %s\n", condition ? "ok  " : "FAIL", description);
+	return condition;
+}
+
+static uint32_t ReadConversion(SimulatedMS5611& sensor)
+{
+	uint8_t data[3] = { 0, 0, 0 };
+
+	sensor.Write(MS5611_ADC_READ);
+	sensor.Read(data, sizeof(data));
+
+	return ((uint32_t) data[0] << 16) | ((uint32_t) data[1] << 8) | data[2];
+}
+
+static bool CheckDatasheetExample()
+{
+	printf("Datasheet example\n");
+
+	SimulatedMS5611 sensor;
+	int32_t temperature, pressure;
+
+	MS5611::Compensate(sensor.Prom(), 9085466, 8569150, temperature, pressure);
+	printf("  Temperature: %d; Pressure: %d\n", temperature, pressure);
+
+	bool ok = Check(temperature == 2007, "temperature is 20.07 C");
+	ok &= Check(pressure == 100009, "pressure is 1000.09 mbar");
+
+	return ok;
+}
+
+static bool CheckProm()
+{
+	printf("PROM\n");
+
+	SimulatedMS5611 sensor;
+	uint16_t prom[MS5611_PROM_SIZE];
+
+	// Read the words MSB first, like the Barometer module does
+	for (uint8_t address = 0; address < MS5611_PROM_SIZE; ++address)
+	{
+		uint8_t data[2];
+
+		sensor.Write(MS5611_PROM_READ + address * 2);
+		sensor.Read(data, sizeof(data));
+
+		prom[address] = (data[0] << 8) | data[1];
+	}
+
+	bool ok = Check(MS5611::CheckCRC(prom), "CRC of the PROM matches");
+
+	prom[3] ^= 0x0100;
+	ok &= Check(!MS5611::CheckCRC(prom), "CRC detects a flipped bit");
+
+	return ok;
+}
+
+static bool CheckConversionTiming()
+{
+	printf("Conversion timing\n");
+
+	SimulatedMS5611 sensor;
+
+	sensor.Write(MS5611_CONVERT_D1 + OSR);
+	sensor.Advance(CONVERSION_TIME / 2);
+	bool ok = Check(ReadConversion(sensor) == 0, "reading during a conversion returns zero");
+
+	sensor.Write(MS5611_CONVERT_D1 + OSR);
+	sensor.Advance(CONVERSION_TIME);
+	ok &= Check(ReadConversion(sensor) != 0, "reading after the conversion time returns the sample");
+	ok &= Check(ReadConversion(sensor) == 0, "the sample can only be read once");
+
+	return ok;
+}
+
+static bool CheckCompensation()
+{
+	printf("Compensation over the operating range\n");
+
+	SimulatedMS5611 sensor;
+	int32_t maxTemperatureError = 0, maxPressureError = 0;
+
+	// Covers the first and both second order compensation ranges
+	for (int32_t temperature = -40; temperature <= 85; temperature += 5)
+	{
+		for (int32_t altitude = -500; altitude <= 9000; altitude += 500)
+		{
+			sensor.SetTemperature(temperature);
+			sensor.SetAltitude(altitude);
+
+			sensor.Write(MS5611_CONVERT_D2 + OSR);
+			sensor.Advance(CONVERSION_TIME);
+			uint32_t d2 = ReadConversion(sensor);
+
+			sensor.Write(MS5611_CONVERT_D1 + OSR);
+			sensor.Advance(CONVERSION_TIME);
+			uint32_t d1 = ReadConversion(sensor);
+
+			int32_t compensatedTemperature, compensatedPressure;
+			MS5611::Compensate(sensor.Prom(), d1, d2, compensatedTemperature, compensatedPressure);
+
+			int32_t temperatureError = abs(compensatedTemperature - temperature * 100);
+			int32_t pressureError = abs(compensatedPressure - (int32_t) lroundf(sensor.Pressure()));
+
+			if (temperatureError > maxTemperatureError) maxTemperatureError = temperatureError;
+			if (pressureError > maxPressureError) maxPressureError = pressureError;
+		}
+	}
+
+	printf("  Largest error: %d (0.01 C); %d Pa\n", maxTemperatureError, maxPressureError);
+
+	bool ok = Check(maxTemperatureError <= 1, "temperature within 0.01 C");
+	ok &= Check(maxPressureError <= 2, "pressure within 2 Pa");
+
+	return ok;
+}
+
+// Vertical acceleration (m/s^2) of the simulated climb: 2 m/s up between 2 and 8 s, with a second to speed up and to slow down
+static float ClimbAcceleration(float time)
+{
+	if (time >= 2.0f && time < 3.0f)
+		return 2.0f;
+
+	if (time >= 7.0f && time < 8.0f)
+		return -2.0f;
+
+	return 0.0f;
+}
+
+// Runs the barometer conversion schedule and the estimator through the climb, returns the largest velocity and altitude errors
+static void Fly(bool filtered, float& velocityError, float& altitudeError)
+{
+	SimulatedMS5611 sensor;
+	sensor.SetNoise(6.0f);
+
+	AltitudeEstimator estimator;
+	estimator.SetTimeConstant(ESTIMATOR_TC);
+	estimator.Reset(0.0f);
+
+	float altitude = 0.0f, velocity = 0.0f;
+
+	// Specific force measured by the accelerometer, as the filter of the motion sensor holds it in rest
+	float measured = GRAVITY;
+
+	uint32_t conversionTime = 0, rawTemperature = 0;
+	uint8_t pressureSamples = 0;
+	bool convertingTemperature = true;
+
+	float groundPressure = 0.0f, baroAltitude = 0.0f;
+
+	sensor.Write(MS5611_CONVERT_D2 + OSR);
+
+	velocityError = 0.0f;
+	altitudeError = 0.0f;
+
+	srand(1);
+
+	for (uint32_t time = 0; time < 12000000; time += DT)
+	{
+		float seconds = time * 1e-6f;
+		float dt = DT * 1e-6f;
+
+		float acceleration = ClimbAcceleration(seconds);
+		velocity += acceleration * dt;
+		altitude += velocity * dt;
+
+		sensor.SetAltitude(altitude);
+		sensor.Advance(DT);
+
+		// Accelerometer noise of about 0.05 m/s^2
+		float specificForce = acceleration + GRAVITY + 0.1f * (rand() / (float) RAND_MAX - 0.5f);
+
+		if (filtered)
+			measured += (specificForce - measured) * (dt / (ACCEL_FILTER_RC + dt));
+		else
+			measured = specificForce;
+
+		// Same schedule as Barometer::Loop
+		conversionTime += DT;
+
+		if (conversionTime >= CONVERSION_TIME)
+		{
+			uint32_t value = ReadConversion(sensor);
+
+			if (convertingTemperature)
+				rawTemperature = value;
+			else if (value != 0 && rawTemperature != 0)
+			{
+				int32_t temperature, pressure;
+				MS5611::Compensate(sensor.Prom(), value, rawTemperature, temperature, pressure);
+
+				if (groundPressure == 0.0f)
+					groundPressure = pressure;
+
+				baroAltitude = 44330.0f * (1.0f - powf(pressure / groundPressure, 0.190295f));
+			}
+
+			if (!convertingTemperature && ++pressureSamples >= TEMPERATURE_INTERVAL)
+			{
+				pressureSamples = 0;
+				convertingTemperature = true;
+				sensor.Write(MS5611_CONVERT_D2 + OSR);
+			}
+			else
+			{
+				convertingTemperature = false;
+				sensor.Write(MS5611_CONVERT_D1 + OSR);
+			}
+
+			conversionTime = 0;
+		}
+
+		estimator.Update(measured - GRAVITY, baroAltitude, dt);
+
+		if (fabsf(estimator.VerticalVelocity() - velocity) > velocityError)
+			velocityError = fabsf(estimator.VerticalVelocity() - velocity);
+
+		if (fabsf(estimator.Altitude() - altitude) > altitudeError)
+			altitudeError = fabsf(estimator.Altitude() - altitude);
+	}
+}
+
+static bool CheckAltitudeEstimate()
+{
+	printf("Altitude estimate during a 10 m climb\n");
+
+	float rawVelocityError, rawAltitudeError;
+	float filteredVelocityError, filteredAltitudeError;
+
+	Fly(false, rawVelocityError, rawAltitudeError);
+	Fly(true, filteredVelocityError, filteredAltitudeError);
+
+	printf("  Unfiltered accelerometer: velocity error %.3f m/s; altitude error %.3f m\n", rawVelocityError, rawAltitudeError);
+	printf("  Filtered accelerometer:   velocity error %.3f m/s; altitude error %.3f m\n", filteredVelocityError, filteredAltitudeError);
+
+	bool ok = Check(rawVelocityError < 0.3f, "velocity within 0.3 m/s");
+	ok &= Check(rawAltitudeError < 0.5f, "altitude within 0.5 m");
+	ok &= Check(rawVelocityError < filteredVelocityError, "unfiltered accelerometer tracks velocity better than the filtered one");
+
+	return ok;
+}
+
+int main()
+{
+	bool ok = true;
+
+	ok &= CheckDatasheetExample();
+	ok &= CheckProm();
+	ok &= CheckConversionTiming();
+	ok &= CheckCompensation();
+	ok &= CheckAltitudeEstimate();
+
+	printf("%s\n", ok ? "All barometer checks passed" : "Barometer checks FAILED");
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,221 @@
+#ifndef _MS5611_SIM_H_
+#define _MS5611_SIM_H_
+
+#include <stdint.h>
+#include <math.h>
+
+#include "ms5611.h"
+
+namespace bothezat
+{
+
+/*
+ *	Simulated MS5611 on the host. Responds to the same commands as the sensor: PROM reads return the datasheet
+ *	example calibration with a valid CRC, and conversions produce the raw samples that compensate to the simulated
+ *	altitude and temperature. Reading the ADC before a conversion finished returns zero, like the real sensor.
+ */
+class SimulatedMS5611
+{
+
+public:
+	// Sea level pressure (Pa) of the standard atmosphere
+	static const int32_t SEA_LEVEL_PRESSURE = 101325;
+
+private:
+	uint16_t prom[MS5611_PROM_SIZE];
+
+	// Time (us) the current conversion still needs, and its result
+	int32_t conversionLeft;
+	uint32_t conversionResult;
+	bool converting;
+
+	// Register pointer of the last command that selects data to read
+	uint8_t readCommand;
+
+	float altitude, temperature;
+
+	// Peak amplitude of the pressure noise (Pa), and the state of its generator
+	float noise;
+	uint32_t noiseState;
+
+public:
+	SimulatedMS5611() : conversionLeft(0), conversionResult(0), converting(false), readCommand(MS5611_ADC_READ),
+		altitude(0.0f), temperature(20.0f), noise(0.0f), noiseState(12345)
+	{
+		// Calibration of the example in the datasheet
+		prom[0] = 0;
+		prom[1] = 40127;
+		prom[2] = 36924;
+		prom[3] = 23317;
+		prom[4] = 23282;
+		prom[5] = 33464;
+		prom[6] = 28312;
+		prom[7] = 0;
+
+		prom[7] |= CalculateCRC(prom);
+	}
+
+	void SetAltitude(float altitude) { this->altitude = altitude; }
+	void SetTemperature(float temperature) { this->temperature = temperature; }
+	void SetNoise(float noise) { this->noise = noise; }
+
+	const uint16_t* Prom() const { return prom; }
+
+	// Pressure (Pa) at the simulated altitude, the inverse of the barometric formula
+	float Pressure() const
+	{
+		return SEA_LEVEL_PRESSURE * powf(1.0f - altitude / 44330.0f, 1.0f / 0.190295f);
+	}
+
+	// Lets time pass on the sensor (us)
+	void Advance(uint32_t time)
+	{
+		conversionLeft -= time;
+	}
+
+	// Handles a command byte written over I2C
+	void Write(uint8_t command)
+	{
+		if (command == MS5611_RESET)
+		{
+			converting = false;
+			conversionResult = 0;
+
+			return;
+		}
+
+		if (command == MS5611_ADC_READ || (command >= MS5611_PROM_READ && command < MS5611_PROM_READ + MS5611_PROM_SIZE * 2))
+		{
+			readCommand = command;
+			return;
+		}
+
+		uint8_t conversion = command & 0xF0;
+		uint8_t osr = command & 0x0F;
+
+		if ((conversion != MS5611_CONVERT_D1 && conversion != MS5611_CONVERT_D2) || osr > MS5611_OSR_4096 || (osr & 1) != 0)
+			return;
+
+		static const int32_t CONVERSION_TIMES[] = { MS5611_CONVERSION_256, MS5611_CONVERSION_512, MS5611_CONVERSION_1024,
+													MS5611_CONVERSION_2048, MS5611_CONVERSION_4096 };
+
+		converting = true;
+		conversionLeft = CONVERSION_TIMES[osr / 2];
+
+		int32_t temperatureTarget = (int32_t) lroundf(temperature * 100.0f);
+		uint32_t d2 = FindD2(temperatureTarget);
+
+		if (conversion == MS5611_CONVERT_D2)
+			conversionResult = d2;
+		else
+			conversionResult = FindD1(d2, (int32_t) lroundf(Pressure() + NextNoise()));
+	}
+
+	// Reads the data selected by the last command, MSB first
+	void Read(uint8_t* data, uint8_t length)
+	{
+		if (readCommand == MS5611_ADC_READ)
+		{
+			// A read during or without a conversion returns zero, and the result can only be read once
+			uint32_t value = (converting && conversionLeft <= 0) ? conversionResult : 0;
+			converting = false;
+
+			for (uint8_t idx = 0; idx < length && idx < 3; ++idx)
+				data[idx] = value >> (16 - idx * 8);
+
+			return;
+		}
+
+		uint16_t word = prom[(readCommand - MS5611_PROM_READ) / 2];
+
+		for (uint8_t idx = 0; idx < length && idx < 2; ++idx)
+			data[idx] = word >> (8 - idx * 8);
+	}
+
+	// CRC-4 of the PROM as given in application note AN520
+	static uint16_t CalculateCRC(const uint16_t* prom)
+	{
+		uint16_t words[MS5611_PROM_SIZE];
+
+		for (uint8_t idx = 0; idx < MS5611_PROM_SIZE; ++idx)
+			words[idx] = prom[idx];
+
+		words[7] &= 0xFF00;
+
+		uint16_t remainder = 0;
+
+		for (uint8_t count = 0; count < 16; ++count)
+		{
+			if (count % 2 == 1)
+				remainder ^= words[count >> 1] & 0x00FF;
+			else
+				remainder ^= words[count >> 1] >> 8;
+
+			for (uint8_t bit = 8; bit > 0; --bit)
+			{
+				if (remainder & 0x8000)
+					remainder = (remainder << 1) ^ 0x3000;
+				else
+					remainder = remainder << 1;
+			}
+		}
+
+		return (remainder >> 12) & 0x000F;
+	}
+
+private:
+	// Raw temperature that compensates to the given temperature (0.01 degC), the compensation is monotonic in it
+	uint32_t FindD2(int32_t target) const
+	{
+		uint32_t low = 0, high = 1UL << 24;
+
+		while (high - low > 1)
+		{
+			uint32_t mid = (low + high) / 2;
+			int32_t temperature, pressure;
+
+			MS5611::Compensate(prom, 0, mid, temperature, pressure);
+
+			if (temperature <= target)
+				low = mid;
+			else
+				high = mid;
+		}
+
+		return low;
+	}
+
+	// Raw pressure that compensates to the given pressure (Pa) at the given raw temperature
+	uint32_t FindD1(uint32_t d2, int32_t target) const
+	{
+		uint32_t low = 0, high = 1UL << 24;
+
+		while (high - low > 1)
+		{
+			uint32_t mid = (low + high) / 2;
+			int32_t temperature, pressure;
+
+			MS5611::Compensate(prom, mid, d2, temperature, pressure);
+
+			if (pressure <= target)
+				low = mid;
+			else
+				high = mid;
+		}
+
+		return low;
+	}
+
+	// Uniform noise within the configured amplitude
+	float NextNoise()
+	{
+		noiseState = noiseState * 1103515245UL + 12345UL;
+
+		return noise * (((noiseState >> 8) & 0xFFFF) / 32767.5f - 1.0f);
+	}
+
+};
+
+}
+
+#endif
@@ -0,0 +1,237 @@
+/*
+ *	Checks the S.BUS and Spektrum frame parsers on the host with byte streams laid out as the receivers send them.
+ *
+ *	The streams are fed byte by byte like the serial receiver does, with a call to Reset() where the line was idle
+ *	for longer than the frame gap. Besides clean frames they contain the cases the receiver depends on: garbage and
+ *	partial frames to resynchronize after, S.BUS2 footers, and the frame lost and failsafe flags.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "sbus_parser.h"
+#include "spektrum_parser.h"
+
+using namespace bothezat;
+
+// Marks an idle line in a stream, the parser is reset there
+static const int GAP = -1;
+
+static bool Check(bool condition, const char* description)
+{
+	printf("  %s: %s\n", condition ? "ok  " : "FAIL", description);
+	return condition;
+}
+
+// Feeds a stream to a parser, returns the amount of completed frames
+template <class Parser>
+static int Feed(Parser& parser, const int* stream, int length)
+{
+	int frames = 0;
+
+	for (int idx = 0; idx < length; ++idx)
+	{
+		if (stream[idx] == GAP)
+			parser.Reset();
+		else if (parser.Feed((uint8_t) stream[idx]))
+			++frames;
+	}
+
+	return frames;
+}
+
+// Packs 16 channels of 11 bits LSB first, as the S.BUS transmitter does
+static void EncodeSbus(int* frame, const uint16_t* channels, uint8_t flags, uint8_t footer)
+{
+	uint8_t data[22];
+	memset(data, 0, sizeof(data));
+
+	for (int bit = 0; bit < 16 * 11; ++bit)
+	{
+		if (channels[bit / 11] & (1 << (bit % 11)))
+			data[bit / 8] |= 1 << (bit % 8);
+	}
+
+	frame[0] = SbusParser::HEADER;
+
+	for (int idx = 0; idx < 22; ++idx)
+		frame[1 + idx] = data[idx];
+
+	frame[23] = flags;
+	frame[24] = footer;
+}
+
+// All channels centered (992), as a receiver sends it with the sticks centered
+static const int SBUS_CENTERED[] =
+{
+	0x0F, 0xE0, 0x03, 0x1F, 0xF8, 0xC0, 0x07, 0x3E, 0xF0, 0x81, 0x0F, 0x7C, 0xE0, 0x03, 0x1F, 0xF8,
+	0xC0, 0x07, 0x3E, 0xF0, 0x81, 0x0F, 0x7C, 0x00, 0x00
+};
+
+static bool CheckSbus()
+{
+	printf("S.BUS\n");
+
+	bool ok = true;
+	SbusParser parser;
+
+	// Centered frame
+	ok &= Check(Feed(parser, SBUS_CENTERED, SbusParser::FRAME_SIZE) == 1, "centered frame is accepted");
+
+	bool centered = true;
+
+	for (uint8_t channel = 0; channel < SbusParser::CHANNELS; ++channel)
+		centered &= parser.Channel(channel) == 992 && parser.PulseLength(channel) == 1500;
+
+	ok &= Check(centered, "all channels decode to 992, 1500 us");
+	ok &= Check(!parser.Failsafe() && !parser.FrameLost(), "no flags set");
+
+	// Distinct value on every channel, so any bit that ends up in the wrong channel is noticed
+	uint16_t channels[SbusParser::CHANNELS];
+
+	for (uint8_t channel = 0; channel < SbusParser::CHANNELS; ++channel)
+		channels[channel] = 172 + channel * 109;
+
+	int frame[SbusParser::FRAME_SIZE];
+	EncodeSbus(frame, channels, 0, 0x00);
+
+	parser = SbusParser();
+	Feed(parser, frame, SbusParser::FRAME_SIZE);
+
+	bool decoded = true;
+
+	for (uint8_t channel = 0; channel < SbusParser::CHANNELS; ++channel)
+		decoded &= parser.Channel(channel) == channels[channel];
+
+	ok &= Check(decoded, "distinct channel values decode in place");
+	ok &= Check(parser.PulseLength(0) == 988 && parser.PulseLength(15) == 2009, "pulse lengths scale from 172 ... 1811");
+
+	// S.BUS2 footers are accepted, anything else discards the frame
+	EncodeSbus(frame, channels, 0, 0x14);
+	ok &= Check(Feed(parser, frame, SbusParser::FRAME_SIZE) == 1, "S.BUS2 footer is accepted");
+
+	EncodeSbus(frame, channels, 0, 0x55);
+	ok &= Check(Feed(parser, frame, SbusParser::FRAME_SIZE) == 0, "invalid footer discards the frame");
+
+	// Flags
+	EncodeSbus(frame, channels, SbusParser::FLAG_FRAME_LOST, 0x00);
+	Feed(parser, frame, SbusParser::FRAME_SIZE);
+	ok &= Check(parser.FrameLost() && !parser.Failsafe(), "frame lost flag");
+
+	EncodeSbus(frame, channels, SbusParser::FLAG_FRAME_LOST | SbusParser::FLAG_FAILSAFE, 0x00);
+	Feed(parser, frame, SbusParser::FRAME_SIZE);
+	ok &= Check(parser.Failsafe(), "failsafe flag");
+
+	Feed(parser, SBUS_CENTERED, SbusParser::FRAME_SIZE);
+	ok &= Check(!parser.Failsafe() && !parser.FrameLost(), "flags clear with the next good frame");
+
+	// Garbage that contains header bytes, then a gap and two good frames
+	static const int garbage[] = { 0x3C, 0x0F, 0x81, 0x0F, 0x00, 0xFF, 0x0F, 0x12, GAP };
+
+	int stream[sizeof(garbage) / sizeof(int) + SbusParser::FRAME_SIZE * 2];
+	int length = 0;
+
+	for (unsigned idx = 0; idx < sizeof(garbage) / sizeof(int); ++idx)
+		stream[length++] = garbage[idx];
+
+	for (int idx = 0; idx < SbusParser::FRAME_SIZE; ++idx)
+		stream[length++] = frame[idx];
+
+	for (int idx = 0; idx < SbusParser::FRAME_SIZE; ++idx)
+		stream[length++] = SBUS_CENTERED[idx];
+
+	parser = SbusParser();
+	ok &= Check(Feed(parser, stream, length) == 2, "resynchronizes on the gap after garbage");
+	ok &= Check(parser.Channel(3) == 992, "frame after garbage decodes");
+
+	// A frame cut off by a gap is dropped, the frame after it is not affected
+	int partial[12 + 1 + SbusParser::FRAME_SIZE];
+	length = 0;
+
+	for (int idx = 0; idx < 12; ++idx)
+		partial[length++] = frame[idx];
+
+	partial[length++] = GAP;
+
+	for (int idx = 0; idx < SbusParser::FRAME_SIZE; ++idx)
+		partial[length++] = SBUS_CENTERED[idx];
+
+	parser = SbusParser();
+	ok &= Check(Feed(parser, partial, length) == 1 && parser.Channel(0) == 992, "partial frame is dropped on the gap");
+
+	return ok;
+}
+
+// Frame of a DSM2 1024 satellite, throttle low and the sticks centered
+static const int SPEKTRUM_1024[] =
+{
+	0x00, 0x01, 0x00, 0x00, 0x05, 0xFF, 0x09, 0xFF, 0x0E, 0x00, 0x11, 0xFF, 0x16, 0xAA, 0xFF, 0xFF
+};
+
+// Two frames of a DSMX 2048 satellite with 8 channels, each carrying a different subset of channels
+static const int SPEKTRUM_2048[] =
+{
+	0x00, 0xB2, 0x04, 0x00, 0x0B, 0xFF, 0x13, 0xFF, 0x1C, 0x00, 0x2C, 0x00, 0x34, 0x00, 0xFF, 0xFF, GAP,
+	0x00, 0xB2, 0x27, 0xFF, 0x3C, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
+
+static bool CheckSpektrum()
+{
+	printf("Spektrum\n");
+
+	bool ok = true;
+	SpektrumParser parser;
+
+	ok &= Check(Feed(parser, SPEKTRUM_1024, SpektrumParser::FRAME_SIZE) == 1, "DSM2 1024 frame is accepted");
+	ok &= Check(!parser.IsHighResolution(), "DSM2 1024 system uses 10 bit values");
+	ok &= Check(parser.Channel(0) == 0 && parser.Channel(1) == 0x1FF && parser.Channel(2) == 0x1FF && parser.Channel(3) == 0x200,
+				"channel ids and values decode");
+	ok &= Check(parser.Channel(5) == 0x2AA, "aux channel decodes");
+	ok &= Check(parser.PulseLength(0) == 988 && parser.PulseLength(3) == 1500, "pulse lengths scale from 988 us");
+
+	parser = SpektrumParser();
+	int length = sizeof(SPEKTRUM_2048) / sizeof(int);
+
+	// The first frame ends where the gap is
+	int firstLength = SpektrumParser::FRAME_SIZE;
+
+	ok &= Check(Feed(parser, SPEKTRUM_2048, firstLength) == 1, "DSMX 2048 frame is accepted");
+	ok &= Check(parser.IsHighResolution(), "DSMX system uses 11 bit values");
+	ok &= Check(parser.Channel(0) == 0x400 && parser.Channel(1) == 0x3FF && parser.Channel(5) == 0x400 && parser.Channel(6) == 0x400,
+				"first frame channels decode");
+
+	ok &= Check(Feed(parser, SPEKTRUM_2048 + firstLength, length - firstLength) == 1, "second frame is accepted");
+	ok &= Check(parser.Channel(4) == 0x7FF && parser.Channel(7) == 0x400, "second frame channels decode");
+	ok &= Check(parser.Channel(0) == 0x400 && parser.Channel(1) == 0x3FF, "channels missing from the second frame are kept");
+	ok &= Check(parser.PulseLength(0) == 1500 && parser.PulseLength(4) == 988 + 1023, "pulse lengths scale from 988 us");
+
+	// Garbage bytes before a gap shift the frame if the parser doesn't start over
+	static const int garbage[] = { 0x12, 0x34, 0x56, GAP };
+
+	int stream[sizeof(garbage) / sizeof(int) + SpektrumParser::FRAME_SIZE];
+	length = 0;
+
+	for (unsigned idx = 0; idx < sizeof(garbage) / sizeof(int); ++idx)
+		stream[length++] = garbage[idx];
+
+	for (int idx = 0; idx < SpektrumParser::FRAME_SIZE; ++idx)
+		stream[length++] = SPEKTRUM_1024[idx];
+
+	parser = SpektrumParser();
+	ok &= Check(Feed(parser, stream, length) == 1 && parser.Channel(3) == 0x200 && !parser.IsHighResolution(),
+				"resynchronizes on the gap after garbage");
+
+	return ok;
+}
+
+int main()
+{
+	bool ok = true;
+
+	ok &= CheckSbus();
+	ok &= CheckSpektrum();
+
+	printf("%s\n", ok ? "All receiver parser checks passed" : "Receiver parser checks FAILED");
+
+	return ok ? 0 : 1;
+}
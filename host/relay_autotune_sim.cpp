@@ -0,0 +1,204 @@
+/*
+ *	Runs the relay autotune against a simulated airframe axis on the host.
+ *
+ *	The axis is modelled as the angular rate of a body with inertia and aerodynamic damping, driven through a first
+ *	order motor lag and read back with a sensor delay. The point of the frequency response the relay identifies
+ *	follows from the model, which the relay estimate is compared against. The Ziegler-Nichols gains are then checked
+ *	by closing the loop around the same model with a PID controller of the same form as the flight controller uses.
+ */
+
+#include <stdio.h>
+#include <math.h>
+
+#include "relay_autotune.h"
+
+using namespace bothezat;
+
+// Same relay settings as the MotorController uses
+static const float AUTOTUNE_AMPLITUDE = 0.1f;
+static const float AUTOTUNE_HYSTERESIS = 0.002f;
+static const float AUTOTUNE_TIMEOUT = 20.0f;
+
+// Control loop interval (s)
+static const float DT = 0.002f;
+
+static const int MAX_DELAY_STEPS = 64;
+
+// Single axis of the airframe, the rate is normalized like the rate controllers do (1 = 500 deg/s)
+struct Axis
+{
+	// Motor time constant (s), torque per unit of motor command, damping (1/s) and sensor delay (s)
+	float motorLag, torqueGain, damping, sensorDelay;
+
+	float thrust, rate;
+
+	float delayLine[MAX_DELAY_STEPS];
+	int delaySteps, delayIdx;
+
+	Axis(float motorLag, float torqueGain, float damping, float sensorDelay) :
+		motorLag(motorLag), torqueGain(torqueGain), damping(damping), sensorDelay(sensorDelay), thrust(0.0f), rate(0.0f), delayIdx(0)
+	{
+		delaySteps = (int) (sensorDelay / DT + 0.5f);
+
+		for (int idx = 0; idx < MAX_DELAY_STEPS; ++idx)
+			delayLine[idx] = 0.0f;
+	}
+
+	// Advances the model with the motor command and returns the rate as measured by the sensor
+	float Step(float command)
+	{
+		thrust += (command - thrust) * (DT / motorLag);
+		rate += (torqueGain * thrust - damping * rate) * DT;
+
+		delayLine[delayIdx] = rate;
+		delayIdx = (delayIdx + 1) % (delaySteps + 1);
+
+		return delayLine[delayIdx];
+	}
+
+	// Phase (rad) of the frequency response at the given frequency (rad/s)
+	float Phase(float omega) const
+	{
+		return -omega * sensorDelay - atanf(omega * motorLag) - atanf(omega / damping);
+	}
+
+	// Magnitude of the frequency response at the given frequency (rad/s)
+	float Magnitude(float omega) const
+	{
+		return torqueGain / (sqrtf(1.0f + omega * omega * motorLag * motorLag) * sqrtf(damping * damping + omega * omega));
+	}
+
+	// Frequency (rad/s) at which the phase crosses the given phase
+	float PhaseCrossing(float phase) const
+	{
+		float low = 0.0f, high = 1000.0f;
+
+		for (int iteration = 0; iteration < 100; ++iteration)
+		{
+			float omega = 0.5f * (low + high);
+
+			if (Phase(omega) > phase)
+				low = omega;
+			else
+				high = omega;
+		}
+
+		return 0.5f * (low + high);
+	}
+};
+
+// Parallel form PID with derivative on the measurement, like MotorController::PidController
+struct Pid
+{
+	float kp, ki, kd;
+	float integratedError, lastInput;
+
+	Pid(float kp, float ki, float kd) : kp(kp), ki(ki), kd(kd), integratedError(0.0f), lastInput(0.0f)
+	{
+
+	}
+
+	float Update(float target, float input)
+	{
+		float error = target - input;
+		integratedError += error * DT;
+
+		float deltaInput = (input - lastInput) / DT;
+		lastInput = input;
+
+		return kp * error + ki * integratedError - kd * deltaInput;
+	}
+};
+
+static bool Check(bool condition, const char* description)
+{
+	printf("  %s: %s\n", condition ? "ok  " : "FAIL", description);
+	return condition;
+}
+
+static bool RunAxis(const char* name, const Axis& model)
+{
+	printf("%s\n", name);
+
+	// Identify the axis, the setpoint stays at zero like when the autotune is started in a hover
+	Axis axis = model;
+	RelayAutotune autotune;
+	autotune.Start(AUTOTUNE_AMPLITUDE, AUTOTUNE_HYSTERESIS, AUTOTUNE_TIMEOUT);
+
+	float input = 0.0f;
+
+	while (autotune.IsRunning())
+		input = axis.Step(autotune.Update(0.0f - input, DT));
+
+	bool ok = Check(autotune.CurrentState() == RelayAutotune::FINISHED, "identification finished");
+
+	if (!ok)
+		return false;
+
+	// True ultimate point of the model, where the phase crosses -180 degrees
+	float ultimateOmega = model.PhaseCrossing(-M_PI);
+
+	printf("  Ku: %.3f; Tu: %.3f s (model ultimate point: Ku %.3f; Tu %.3f s)\n", autotune.UltimateGain(), autotune.UltimatePeriod(),
+		   1.0f / model.Magnitude(ultimateOmega), 2.0f * M_PI / ultimateOmega);
+	printf("  P: %.3f; I: %.3f; D: %.4f\n", autotune.Kp(), autotune.Ki(), autotune.Kd());
+
+	// The hysteresis delays the relay by asin(e / a), so it oscillates where the phase of the model is that much above -180 degrees.
+	// The oscillation amplitude a follows from the estimate, as Ku = 4d / (pi * sqrt(a^2 - e^2))
+	float offset = 4.0f * AUTOTUNE_AMPLITUDE / (M_PI * autotune.UltimateGain());
+	float oscillation = sqrtf(offset * offset + AUTOTUNE_HYSTERESIS * AUTOTUNE_HYSTERESIS);
+	float relayLag = asinf(AUTOTUNE_HYSTERESIS / oscillation);
+
+	float relayOmega = model.PhaseCrossing(-M_PI + relayLag);
+	float expectedGain = 1.0f / (model.Magnitude(relayOmega) * cosf(relayLag));
+	float expectedPeriod = 2.0f * M_PI / relayOmega;
+
+	float gainError = autotune.UltimateGain() / expectedGain - 1.0f;
+	float periodError = autotune.UltimatePeriod() / expectedPeriod - 1.0f;
+
+	printf("  Relay point of the model: Ku %.3f (%+.1f%%); Tu %.3f s (%+.1f%%)\n", expectedGain, gainError * 100.0f, expectedPeriod, periodError * 100.0f);
+
+	// The describing function ignores the harmonics of the relay output, the estimate is expected within these margins
+	ok &= Check(fabsf(gainError) < 0.15f, "gain estimate within 15% of the model");
+	ok &= Check(fabsf(periodError) < 0.10f, "period estimate within 10% of the model");
+
+	// Close the loop with the tuned gains and step the setpoint to 100 deg/s
+	axis = model;
+	Pid pid(autotune.Kp(), autotune.Ki(), autotune.Kd());
+
+	const float target = 0.2f;
+	float peak = 0.0f, settledError = 0.0f;
+	input = 0.0f;
+
+	for (float time = 0.0f; time < 3.0f; time += DT)
+	{
+		input = axis.Step(pid.Update(target, input));
+
+		if (input > peak)
+			peak = input;
+
+		// Largest error in the last second
+		if (time > 2.0f && fabsf(target - input) > settledError)
+			settledError = fabsf(target - input);
+	}
+
+	printf("  Step: overshoot %.1f%%; error after 2 s %.2f%%\n", (peak / target - 1.0f) * 100.0f, settledError / target * 100.0f);
+
+	ok &= Check(peak < 2.0f * target, "closed loop step stays bounded");
+	ok &= Check(settledError < 0.02f * target, "closed loop step settles within 2%");
+
+	return ok;
+}
+
+int main()
+{
+	bool ok = true;
+
+	//								Motor lag	Torque		Damping		Sensor delay
+	ok &= RunAxis("Small quad",		Axis(0.02f,		40.0f,		2.0f,		0.004f));
+	ok &= RunAxis("Large quad",		Axis(0.05f,		15.0f,		1.0f,		0.004f));
+	ok &= RunAxis("Filtered gyro",	Axis(0.03f,		25.0f,		2.0f,		0.012f));
+
+	printf("%s\n", ok ? "All autotune checks passed" : "Autotune checks FAILED");
+
+	return ok ? 0 : 1;
+}
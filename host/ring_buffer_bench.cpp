@@ -0,0 +1,310 @@
+/*
+ *	Checks the RingBuffer on the host and times it against the previous implementation.
+ *
+ *	The checks cover what the serial interface depends on: wrap-around, a full buffer that is not mistaken for an
+ *	empty one, the span API and the single producer single consumer buffer. The timings run the same transfers
+ *	through both implementations, they are only reported and never fail the run.
+ */
+
+#include <stdio.h>
+#include <time.h>
+
+#include "Arduino.h"
+#include "ring_buffer.h"
+#include "ring_buffer_baseline.h"
+
+using namespace bothezat;
+
+static const uint32_t BUFFER_SIZE = 4096;
+static const uint32_t ITERATIONS = 200000;
+
+// Keeps the compiler from dropping the timed transfers
+static volatile uint32_t sink;
+
+static bool Check(bool condition, const char* description)
+{
+	printf("  %s: %s\n", condition ? "ok  " : "FAIL", description);
+	return condition;
+}
+
+static double Now()
+{
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+
+	return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+static bool CheckWrapAround()
+{
+	printf("Wrap-around\n");
+
+	RingBuffer buffer;
+	buffer.Allocate(64);
+
+	uint8_t in[64], out[64];
+
+	for (uint32_t idx = 0; idx < sizeof(in); ++idx)
+		in[idx] = idx * 7;
+
+	// Lengths around the small copy size and the capacity, so the offsets wrap at every position
+	bool intact = true;
+
+	for (uint32_t round = 0; round < 200; ++round)
+	{
+		uint32_t length = 1 + (round * 13) % sizeof(in);
+
+		uint32_t written = buffer.writeStream.Write(in, length);
+		uint32_t read = buffer.readStream.Read(out, written);
+		buffer.Trim();
+
+		intact &= written == length && read == written && memcmp(in, out, length) == 0;
+	}
+
+	bool ok = Check(intact, "data is intact across the end of the buffer");
+
+	// The scalar overloads are only visible through the base, like the modules serialize through it
+	BinaryWriteStream& stream = buffer.writeStream;
+	stream.Write((uint32_t) 0xDEADBEEF);
+	ok &= Check(buffer.readStream.ReadUInt32() == 0xDEADBEEF, "scalar values read back");
+	buffer.Trim();
+
+	RingBuffer rounded;
+	rounded.Allocate(100);
+	ok &= Check(rounded.Size() == 128, "capacity rounds up to a power of two");
+
+	return ok;
+}
+
+static bool CheckFull()
+{
+	printf("Full buffer\n");
+
+	RingBuffer buffer;
+	buffer.Allocate(64);
+
+	uint8_t in[80];
+	memset(in, 0x5A, sizeof(in));
+
+	// Start off the beginning of the buffer, so the full write wraps
+	buffer.writeStream.Write(in, 10);
+	buffer.readStream.Seek(10);
+	buffer.Trim();
+
+	bool ok = Check(buffer.writeStream.Write(in, sizeof(in)) == 64, "write stops at the capacity");
+	ok &= Check(buffer.FreeBytes() == 0 && buffer.UsedBytes() == 64, "full buffer has no free bytes");
+	ok &= Check(buffer.readStream.Available() == 64, "full buffer is not mistaken for an empty one");
+	ok &= Check(buffer.writeStream.Write(in, 1) == 0, "write to a full buffer is refused");
+
+	return ok;
+}
+
+static bool CheckSpans()
+{
+	printf("Spans\n");
+
+	RingBuffer buffer;
+	buffer.Allocate(64);
+
+	uint8_t in[64];
+
+	for (uint32_t idx = 0; idx < sizeof(in); ++idx)
+		in[idx] = idx;
+
+	buffer.writeStream.Write(in, 48);
+	buffer.readStream.Seek(48);
+	buffer.Trim();
+
+	// The free space wraps, the first span ends at the end of the buffer
+	uint8_t* span;
+	uint32_t length = buffer.writeStream.ReserveSpan(span);
+
+	bool ok = Check(length == 16, "reserved span ends at the end of the buffer");
+
+	memcpy(span, in, length);
+	buffer.writeStream.Commit(length);
+
+	length = buffer.writeStream.ReserveSpan(span);
+	ok &= Check(length == 48, "next span starts at the beginning");
+
+	memcpy(span, in + 16, 8);
+	buffer.writeStream.Commit(8);
+
+	const uint8_t* readSpan;
+	uint32_t first = buffer.readStream.PeekSpan(readSpan);
+
+	bool intact = first == 16 && memcmp(readSpan, in, first) == 0;
+	buffer.readStream.Commit(first);
+
+	uint32_t second = buffer.readStream.PeekSpan(readSpan);
+	intact &= second == 8 && memcmp(readSpan, in + 16, second) == 0;
+	buffer.readStream.Commit(second);
+
+	ok &= Check(intact, "peeked spans hold the committed data");
+	ok &= Check(buffer.readStream.Available() == 0, "committed spans are consumed");
+
+	return ok;
+}
+
+static bool CheckReadTo()
+{
+	printf("ReadTo\n");
+
+	RingBuffer source, destination;
+	source.Allocate(256);
+	destination.Allocate(256);
+
+	uint8_t in[200], out[200];
+
+	for (uint32_t idx = 0; idx < sizeof(in); ++idx)
+		in[idx] = idx ^ 0xA5;
+
+	source.writeStream.Write(in, 100);
+	source.readStream.Seek(100);
+	source.Trim();
+
+	source.writeStream.Write(in, sizeof(in));
+	source.readStream.ReadTo(destination.writeStream, sizeof(in));
+
+	bool ok = Check(destination.readStream.Read(out, sizeof(out)) == sizeof(out) && memcmp(in, out, sizeof(in)) == 0,
+					"copies a wrapped stream in chunks");
+	ok &= Check(source.readStream.Available() == 0, "source is consumed");
+
+	return ok;
+}
+
+static bool CheckSpsc()
+{
+	printf("Single producer single consumer\n");
+
+	SpscRingBuffer<64> buffer;
+	uint8_t in[80], out[80];
+
+	for (uint32_t idx = 0; idx < sizeof(in); ++idx)
+		in[idx] = idx * 3;
+
+	bool ok = Check(buffer.Write(in, sizeof(in)) == 64 && buffer.FreeBytes() == 0, "write stops at the capacity");
+	ok &= Check(!buffer.Write((uint8_t) 1), "byte write to a full buffer is refused");
+	ok &= Check(buffer.Read(out, 40) == 40 && memcmp(in, out, 40) == 0, "partial read");
+
+	buffer.Write(in, 30);
+
+	bool intact = buffer.Read(out, sizeof(out)) == 54 && memcmp(in + 40, out, 24) == 0 && memcmp(in, out + 24, 30) == 0;
+	ok &= Check(intact, "data is intact across the end of the buffer");
+	ok &= Check(buffer.Available() == 0, "empty after reading everything");
+
+	return ok;
+}
+
+// Writes and reads a chunk plus a scalar per iteration, like the serial interface frames a message. Returns ns per iteration
+template <class Buffer>
+static double TimeTransfer(uint32_t chunk)
+{
+	Buffer buffer;
+	buffer.Allocate(BUFFER_SIZE);
+
+	uint8_t in[256], out[256];
+
+	for (uint32_t idx = 0; idx < sizeof(in); ++idx)
+		in[idx] = idx * 7;
+
+	double start = Now();
+
+	for (uint32_t iteration = 0; iteration < ITERATIONS; ++iteration)
+	{
+		buffer.writeStream.Write(in, chunk);
+		static_cast<BinaryWriteStream&>(buffer.writeStream).Write(iteration);
+
+		buffer.readStream.Read(out, chunk);
+		sink += out[chunk - 1] + buffer.readStream.ReadUInt32();
+
+		buffer.Trim();
+	}
+
+	return (Now() - start) * 1e9 / ITERATIONS;
+}
+
+// Calls ReadTo through the base classes like command.h does. Kept out of line, so that neither implementation gets its
+// stream calls devirtualized by inlining into the concrete buffer type. Bytewise is ReadTo as it was with the previous RingBuffer
+__attribute__((noinline)) static void ReadTo(BinaryReadStream& source, BinaryWriteStream& destination, uint32_t length, bool bytewise)
+{
+	if (!bytewise)
+	{
+		source.ReadTo(destination, length);
+		return;
+	}
+
+	while (length-- > 0)
+		destination.Write(source.ReadByte());
+}
+
+// Moves a chunk from one buffer to another with ReadTo, like a message is copied to the transmit buffer
+template <class Buffer>
+static double TimeReadTo(uint32_t chunk, bool bytewise)
+{
+	Buffer source, destination;
+	source.Allocate(BUFFER_SIZE);
+	destination.Allocate(BUFFER_SIZE);
+
+	uint8_t in[256];
+
+	for (uint32_t idx = 0; idx < sizeof(in); ++idx)
+		in[idx] = idx * 7;
+
+	double start = Now();
+
+	for (uint32_t iteration = 0; iteration < ITERATIONS; ++iteration)
+	{
+		source.writeStream.Write(in, chunk);
+
+		ReadTo(source.readStream, destination.writeStream, chunk, bytewise);
+
+		sink += destination.readStream.ReadByte();
+		destination.readStream.Seek(chunk - 1);
+
+		source.Trim();
+		destination.Trim();
+	}
+
+	return (Now() - start) * 1e9 / ITERATIONS;
+}
+
+static void Report(const char* name, double previous, double current)
+{
+	printf("  %-18s previous %8.1f ns; current %7.1f ns (%.1fx)\n", name, previous, current, previous / current);
+}
+
+static void Benchmark()
+{
+	printf("Timing per transfer\n");
+
+	static const uint32_t CHUNKS[] = { 4, 32, 256 };
+
+	for (uint32_t idx = 0; idx < sizeof(CHUNKS) / sizeof(CHUNKS[0]); ++idx)
+	{
+		char name[32];
+
+		snprintf(name, sizeof(name), "%u bytes:", CHUNKS[idx]);
+		Report(name, TimeTransfer<baseline::RingBuffer>(CHUNKS[idx]), TimeTransfer<RingBuffer>(CHUNKS[idx]));
+
+		snprintf(name, sizeof(name), "ReadTo %u bytes:", CHUNKS[idx]);
+		Report(name, TimeReadTo<baseline::RingBuffer>(CHUNKS[idx], true), TimeReadTo<RingBuffer>(CHUNKS[idx], false));
+	}
+}
+
+int main()
+{
+	bool ok = true;
+
+	ok &= CheckWrapAround();
+	ok &= CheckFull();
+	ok &= CheckSpans();
+	ok &= CheckReadTo();
+	ok &= CheckSpsc();
+
+	Benchmark();
+
+	printf("%s\n", ok ? "All ring buffer checks passed" : "Ring buffer checks FAILED");
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,56 @@
+#ifndef _LOOKUP_TABLE_H_
+#define _LOOKUP_TABLE_H_
+
+#include "util.h"
+
+namespace bothezat
+{
+
+/*
+ *	Table of precomputed function values at evenly spaced points in the 0 ... 1 range.
+ *	Values in between points are linearly interpolated.
+ */
+template<uint8_t SIZE>
+class LookupTable
+{
+
+private:
+	float values[SIZE];
+
+public:
+
+	LookupTable()
+	{
+		for (uint8_t idx = 0; idx < SIZE; ++idx)
+			values[idx] = idx / (float) (SIZE - 1);
+	}
+
+	// Samples a function object, which should take and return a float, at each point of the table
+	template<typename Function>
+	void Generate(const Function& function)
+	{
+		for (uint8_t idx = 0; idx < SIZE; ++idx)
+			values[idx] = function(idx / (float) (SIZE - 1));
+	}
+
+	float Evaluate(float x) const
+	{
+		if (x <= 0.0f)
+			return values[0];
+
+		if (x >= 1.0f)
+			return values[SIZE - 1];
+
+		x *= SIZE - 1;
+
+		uint8_t idx = static_cast<uint8_t>(x);
+		float t = x - idx;
+
+		return values[idx] + (values[idx + 1] - values[idx]) * t;
+	}
+
+};
+
+}
+
+#endif
@@ -0,0 +1,146 @@
+#include "Arduino.h"
+#include "bothezat.h"
+
+#include "mixer.h"
+
+using namespace bothezat;
+
+/*
+ *	Motors are numbered counter-clockwise (seen from above), starting with the front or front-right motor.
+ *	Positive pitch output speeds up the back motors, positive roll output the left motors and
+ *	positive yaw output the motors that spin in the same direction as the front(-right) motor.
+ */
+const Mixer::LayoutDescription Mixer::LAYOUTS[Mixer::LAST_LAYOUT] =
+{
+	// QUAD_X
+	{
+		"Quad X", 4,
+		{
+			// Throttle	Pitch		Yaw			Roll
+			{ 1.0f,		-1.0f,		 1.0f,		-1.0f },		// Front-right
+			{ 1.0f,		-1.0f,		-1.0f,		 1.0f },		// Front-left
+			{ 1.0f,		 1.0f,		 1.0f,		 1.0f },		// Back-left
+			{ 1.0f,		 1.0f,		-1.0f,		-1.0f },		// Back-right
+		}
+	},
+
+	// QUAD_PLUS
+	{
+		"Quad +", 4,
+		{
+			// Throttle	Pitch		Yaw			Roll
+			{ 1.0f,		-1.0f,		 1.0f,		 0.0f },		// Front
+			{ 1.0f,		 0.0f,		-1.0f,		 1.0f },		// Left
+			{ 1.0f,		 1.0f,		 1.0f,		 0.0f },		// Back
+			{ 1.0f,		 0.0f,		-1.0f,		-1.0f },		// Right
+		}
+	},
+
+	// HEX_X
+	{
+		"Hex X", 6,
+		{
+			// Throttle	Pitch		Yaw			Roll
+			{ 1.0f,		-1.0f,		 1.0f,		-0.5f },		// Front-right
+			{ 1.0f,		-1.0f,		-1.0f,		 0.5f },		// Front-left
+			{ 1.0f,		 0.0f,		 1.0f,		 1.0f },		// Left
+			{ 1.0f,		 1.0f,		-1.0f,		 0.5f },		// Back-left
+			{ 1.0f,		 1.0f,		 1.0f,		-0.5f },		// Back-right
+			{ 1.0f,		 0.0f,		-1.0f,		-1.0f },		// Right
+		}
+	},
+
+	// OCTO_X
+	{
+		"Octo X", 8,
+		{
+			// Throttle	Pitch		Yaw			Roll
+			{ 1.0f,		-1.0f,		 1.0f,		-0.4142f },		// Front-right
+			{ 1.0f,		-1.0f,		-1.0f,		 0.4142f },		// Front-left
+			{ 1.0f,		-0.4142f,	 1.0f,		 1.0f },		// Left-front
+			{ 1.0f,		 0.4142f,	-1.0f,		 1.0f },		// Left-back
+			{ 1.0f,		 1.0f,		 1.0f,		 0.4142f },		// Back-left
+			{ 1.0f,		 1.0f,		-1.0f,		-0.4142f },		// Back-right
+			{ 1.0f,		 0.4142f,	 1.0f,		-1.0f },		// Right-back
+			{ 1.0f,		-0.4142f,	-1.0f,		-1.0f },		// Right-front
+		}
+	},
+};
+
+Mixer::Mixer() : layout(&LAYOUTS[DEFAULT_LAYOUT])
+{
+
+}
+
+void Mixer::SetLayout(uint8_t layout)
+{
+	if (layout >= LAST_LAYOUT)
+	{
+		Debug::Print("Invalid mixer layout %u, using default\n", layout);
+		layout = DEFAULT_LAYOUT;
+	}
+
+	this->layout = &LAYOUTS[layout];
+}
+
+void Mixer::Mix(const float* input, float* output) const
+{
+	for (uint8_t motorIdx = 0; motorIdx < layout->motorAmount; ++motorIdx)
+	{
+		const float* weights = layout->weights[motorIdx];
+
+		output[motorIdx] = 	weights[THROTTLE] 	* input[THROTTLE] +
+							weights[PITCH] 		* input[PITCH] +
+							weights[YAW] 		* input[YAW] +
+							weights[ROLL] 		* input[ROLL];
+	}
+}
+
+bool Mixer::MixDesaturated(const float* input, float* output) const
+{
+	float minOutput = FLT_MAX;
+	float maxOutput = -FLT_MAX;
+
+	// Mix only the axis outputs, throttle is added once we know how much room is left
+	for (uint8_t motorIdx = 0; motorIdx < layout->motorAmount; ++motorIdx)
+	{
+		const float* weights = layout->weights[motorIdx];
+
+		float axisOutput = 	weights[PITCH] 	* input[PITCH] +
+							weights[YAW] 	* input[YAW] +
+							weights[ROLL] 	* input[ROLL];
+
+		output[motorIdx] = axisOutput;
+
+		minOutput = min(minOutput, axisOutput);
+		maxOutput = max(maxOutput, axisOutput);
+	}
+
+	bool saturated = false;
+	float range = maxOutput - minOutput;
+
+	// If the axis outputs alone span more than the output range, scale all of them down equally
+	float scale = 1.0f;
+
+	if (range > 1.0f)
+	{
+		scale = 1.0f / range;
+
+		minOutput *= scale;
+		maxOutput *= scale;
+
+		saturated = true;
+	}
+
+	// Shift throttle so that the lowest and highest motor stay within range
+	// This assumes all motors have an equal throttle weight, which is true for all layouts
+	float throttle = Util::Clamp(input[THROTTLE], -minOutput, 1.0f - maxOutput);
+
+	if (throttle != input[THROTTLE])
+		saturated = true;
+
+	for (uint8_t motorIdx = 0; motorIdx < layout->motorAmount; ++motorIdx)
+		output[motorIdx] = throttle + output[motorIdx] * scale;
+
+	return saturated;
+}
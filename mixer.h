@@ -0,0 +1,76 @@
+#ifndef _MIXER_H_
+#define _MIXER_H_
+
+#include "Arduino.h"
+#include "bothezat.h"
+
+namespace bothezat
+{
+
+/*
+ *	Converts throttle and axis outputs to per motor outputs using the mixing table of an airframe layout
+ */
+class Mixer
+{
+
+public:
+	enum Layout
+	{
+		QUAD_X = 0,
+		QUAD_PLUS,
+		HEX_X,
+		OCTO_X,
+
+		LAST_LAYOUT
+	};
+
+	// Columns of the mixing table. The axis inputs follow the order of the Rotation axes
+	enum Input
+	{
+		THROTTLE = 0,
+		PITCH,
+		YAW,
+		ROLL,
+
+		INPUT_AMOUNT
+	};
+
+	struct LayoutDescription
+	{
+		const char* name;
+
+		uint8_t motorAmount;
+
+		// Mixing coëfficients for each motor, motors beyond motorAmount are left zero
+		float weights[Config::Constants::MC_MAX_MOTORS][INPUT_AMOUNT];
+	};
+
+	static const Layout DEFAULT_LAYOUT = QUAD_X;
+
+private:
+	static const LayoutDescription LAYOUTS[LAST_LAYOUT];
+
+	const LayoutDescription* layout;
+
+public:
+	Mixer();
+
+	void SetLayout(uint8_t layout);
+
+	// Calculates the output for each motor by multiplying the input vector with the mixing table
+	void Mix(const float* input, float* output) const;
+
+	// Mixes the input while keeping all outputs within the 0 ... 1 range without changing the ratios between axis outputs.
+	// Axis outputs are scaled down if they don't fit the output range and throttle is shifted to make room for them.
+	// Returns true if the input had to be altered to fit the output range
+	bool MixDesaturated(const float* input, float* output) const;
+
+	uint8_t MotorAmount() const { return layout->motorAmount; }
+
+	const char* Name() const { return layout->name; }
+
+};
+
+}
+
+#endif
@@ -10,7 +10,7 @@
 using namespace bothezat;
 
 MotionSensor::MotionSensor() : 
-	orientation(), accelOrientation(), acceleration(), angularVelocity(),
+	orientation(), accelOrientation(), acceleration(), angularVelocity(), rawAngularVelocity(), rawAcceleration(),
 	gyroOffset(), gyroRange(0), accelRange(0), gyroScale(1.0f), accelScale(1.0f),
 	angularVelocityFilter(Filter<Vector3>::HIGH_PASS, 0.1f), accelerationFilter(Filter<Vector3>::LOW_PASS, 0.1f)
 {
@@ -35,11 +35,11 @@ void MotionSensor::Loop(uint32_t dt)
 	float scale = gyroScale * DEG_2_RAD;
 
 	// Convert raw data to scaled and calibrated data
-	ReadGyro(angularVelocity);
-	ReadAcceleration(acceleration);
+	ReadGyro(rawAngularVelocity);
+	ReadAcceleration(rawAcceleration);
 
-	angularVelocity = angularVelocityFilter.Sample(angularVelocity, deltaSeconds);
-	acceleration = accelerationFilter.Sample(acceleration, deltaSeconds);
+	angularVelocity = angularVelocityFilter.Sample(rawAngularVelocity, deltaSeconds);
+	acceleration = accelerationFilter.Sample(rawAcceleration, deltaSeconds);
 
 	// Convert axis rotations to quaternion
 	Quaternion rotation = Quaternion::FromEulerAngles(rotation,
@@ -26,6 +26,12 @@ private:
 	Quaternion orientation, accelOrientation;
 	Vector3 angularVelocity, acceleration;
 
+	// Calibrated angular velocity before the high pass filter, which would decay sustained rotations
+	Vector3 rawAngularVelocity;
+
+	// Calibrated acceleration before the low pass filter, which lags by seconds
+	Vector3 rawAcceleration;
+
 	Filter<Vector3> accelerationFilter;
 	Filter<Vector3> angularVelocityFilter;
 
@@ -45,6 +51,18 @@ public:
 	const Quaternion& CurrentOrientation() const { return orientation; }
 	const Quaternion& AccelerometerOrientation() const { return accelOrientation; }
 
+	// Acceleration in G, in the sensor frame
+	const Vector3& Acceleration() const { return acceleration; }
+
+	// Unfiltered acceleration in G, in the sensor frame
+	const Vector3& RawAcceleration() const { return rawAcceleration; }
+
+	// Angular velocity in radians per second, in the axis order of Rotation
+	const Vector3& AngularVelocity() const { return angularVelocity; }
+
+	// Unfiltered angular velocity in radians per second, in the axis order of Rotation. Used as rate feedback
+	const Vector3& RawAngularVelocity() const { return rawAngularVelocity; }
+
 	
 private:
 	void SetupMPU();
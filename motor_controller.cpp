@@ -8,39 +8,36 @@
 
 using namespace bothezat;
 
-MotorController::MotorController() : receiver(NULL), motionSensor(NULL), flightSystem(NULL), armed(false)
+// All channels are PWML outputs on periphial B of PIOC
+const MotorController::PwmOutput MotorController::PWM_OUTPUTS[Config::Constants::MC_MAX_MOTORS] = 
 {
-	{
-		// Front-right
-		Motor& motor = motors[0];
-		motor.enabled = true;
-		motor.pin = 6;
-		motor.weights = Vector3(-1.0f, 1.0f, -1.0f);
-	}
-
-	{
-		// Front-left
-		Motor& motor = motors[1];
-		motor.enabled = true;
-		motor.pin = 9;
-		motor.weights = Vector3(-1.0f, -1.0f, 1.0f);
-	}
-
-	{
-		// Back-left
-		Motor& motor = motors[2];
-		motor.enabled = true;
-		motor.pin = 8;
-		motor.weights = Vector3(1.0f, 1.0f, 1.0f);
-	}
-
-	{
-		// Back-right
-		Motor& motor = motors[3];
-		motor.enabled = true;
-		motor.pin = 7;
-		motor.weights = Vector3(1.0f, -1.0f, -1.0f);
-	}
+	{ 6, 	7, 	PIOC, 	PIO_PC24B_PWML7 },
+	{ 9, 	4, 	PIOC, 	PIO_PC21B_PWML4 },
+	{ 8, 	5, 	PIOC, 	PIO_PC22B_PWML5 },
+	{ 7, 	6, 	PIOC, 	PIO_PC23B_PWML6 },
+	{ 34, 	0, 	PIOC, 	PIO_PC2B_PWML0 	},
+	{ 36, 	1, 	PIOC, 	PIO_PC4B_PWML1 	},
+	{ 38, 	2, 	PIOC, 	PIO_PC6B_PWML2 	},
+	{ 40, 	3, 	PIOC, 	PIO_PC8B_PWML3 	},
+};
+
+// Pulses of the high rate protocols are repeated as fast as the protocol allows, so that a new command is 
+// output at most one (short) period after the mixer wrote it
+const MotorController::ProtocolDescription MotorController::PROTOCOLS[MotorController::LAST_OUTPUT_PROTOCOL] = 
+{
+	// Name			Clock			Period		Min pulse	Max pulse	Digital
+	{ "PWM",		1000000,		2040000,	1000000,	2000000,	false 	},
+	{ "OneShot125",	21000000,		270000,		125000,		250000,		false	},
+	{ "Multishot",	84000000,		31250,		5000,		25000,		false	},
+	{ "DShot150",	84000000,		6667,		2500,		5000,		true	},
+	{ "DShot300",	84000000,		3333,		1250,		2500,		true	},
+	{ "DShot600",	84000000,		1667,		625,		1250,		true	},
+};
+
+MotorController::MotorController() : protocol(NULL), syncChannels(0), syncChannelAmount(0), configRevision(0), activeControllers(pidControllers), autotuneAxis(NO_AXIS), autotuneControllers(NULL), motionSensor(NULL), receiver(NULL), flightSystem(NULL), armed(false), mixerSaturation(0)
+{
+	for (uint8_t motorIdx = 0; motorIdx < Config::Constants::MC_MAX_MOTORS; ++motorIdx)
+		motors[motorIdx].output = &PWM_OUTPUTS[motorIdx];
 }
 
 void MotorController::Setup()
@@ -49,127 +46,281 @@ void MotorController::Setup()
 	motionSensor = &MotionSensor::Instance();
 	flightSystem = &FlightSystem::Instance();
 
+	mixer.SetLayout(config.MC_MIXER_LAYOUT);
+	Debug::Print("Using %s mixer layout\n", mixer.Name());
+
+	SetProtocol(config.MC_OUTPUT_PROTOCOL);
 	EnablePWM();
 
-	// Enable all motors
-	for (uint8_t motorIdx = 0; motorIdx < Config::Constants::MC_MOTOR_AMOUNT; ++motorIdx)
+	// Enable the motors used by the mixer layout
+	for (uint8_t motorIdx = 0; motorIdx < mixer.MotorAmount(); ++motorIdx)
 	{
 		Motor& motor = motors[motorIdx];
-		EnablePin(motor.pin);	
-		WriteMotor(motor, config.MC_PWM_MIN_OUTPUT);
+		motor.enabled = true;
+
+		EnableOutput(*motor.output);
 	}
 
-	// Initialize all PID controllers
+	EnableChannels();
+	DisableMotors();
+
+	pidControllers[1].enabled = false;
+
+	ApplyConfig();
+}
+
+void MotorController::ApplyConfig()
+{
+	// (Re)configure all PID controllers
 	for (uint8_t axis = 0; axis < 3; ++axis)
 	{
-		PidController& pid = pidControllers[axis];
-		pid.Configure(config.MC_PID_CONFIGURATION[axis]);
+		pidControllers[axis].Configure(config.MC_PID_CONFIGURATION[axis]);
+		rateControllers[axis].Configure(config.MC_RATE_PID_CONFIGURATION[axis]);
 	}
 
-	pidControllers[1].enabled = false;
+	thrustTable.Generate(ThrustLinearization(config.MC_THRUST_LINEARIZATION));
+	throttleTable.Generate(ThrottleCurve(config.MC_THROTTLE_MID, config.MC_THROTTLE_EXPO));
+
+	kpTable.Generate(GainSchedule(config, &Config::PidConfiguration::kp));
+	kiTable.Generate(GainSchedule(config, &Config::PidConfiguration::ki));
+	kdTable.Generate(GainSchedule(config, &Config::PidConfiguration::kd));
+
+	configRevision = config.Revision();
 }
 
 void MotorController::Loop(uint32_t dt)
 {	
+	if (configRevision != config.Revision())
+		ApplyConfig();
+
+	// Last stage of the receiver failsafe
+	if (IsArmed() && receiver->Failsafe() == Receiver::FAILSAFE_DISARM)
+		SetArmState(false);
+
 	if (!IsArmed())
+	{
+		// Digital ESCs need to keep receiving frames to stay initialized
+		FlushMotors();
 		return;
+	}
 	
-	const Quaternion& orientation = motionSensor->CurrentOrientation();
-	const Rotation& desiredRotation = flightSystem->CurrentMode().DesiredRotation();
-	Rotation rotation;
+	UpdateControllers(dt);
+
+	switch (config.MC_MIXER_MODE)
+	{
+		case MIXER_RELATIVE:
+			UpdateMotorsRelative();
+			break;
+
+		case MIXER_NORMALIZED:
+			UpdateMotorsNormalized();
+			break;
+
+		case MIXER_DESATURATED:
+		default:
+			UpdateMotorsDesaturated();
+			break;
+	}
+
+	FlushMotors();
+}
+
+void MotorController::UpdateControllers(uint32_t dt)
+{
+	const FlightSystem::Setpoint& setpoint = flightSystem->CurrentSetpoint();
+
+	Rotation input, target;
+	PidController* controllers;
+
+	if (setpoint.control == FlightMode::CONTROL_RATE)
+	{
+		controllers = rateControllers;
+
+		// Gyro feedback is used directly, no need for the orientation
+		input = motionSensor->RawAngularVelocity() * (RAD_2_DEG / RATE_RANGE);
+		target = setpoint.angularVelocity * (1.0f / RATE_RANGE);
+	}
+	else
+	{
+		controllers = pidControllers;
 
-	// Convert the quaternion orientation to yaw pitch roll rotation
-	orientation.ToEulerAngles(rotation);
+		// Convert the quaternion orientation to yaw pitch roll rotation
+		motionSensor->CurrentOrientation().ToEulerAngles(input);
+		input *= 1.0f / 180.0f;
+		target = setpoint.rotation * (1.0f / 180.0f);
+	}
 
 	float deltaSeconds = dt * 1e-6f;
 
+	// Look up the gain multipliers for the current throttle
+	float throttle = Throttle();
+	float kpScale = kpTable.Evaluate(throttle);
+	float kiScale = kiTable.Evaluate(throttle);
+	float kdScale = kdTable.Evaluate(throttle);
+
+	bool handover = controllers != activeControllers;
+
 	// Update the PidController controllers for each axis
 	for (uint8_t axis = 0; axis < 3; ++axis)
 	{
-		PidController& pid = pidControllers[axis];
+		PidController& pid = controllers[axis];
+		pid.Schedule(kpScale, kiScale, kdScale);
+
+		// Controllers that take over continue where the previous ones left off
+		if (handover)
+			pid.Handover(activeControllers[axis].output, input[axis]);
 
-		pid.target = desiredRotation[axis] / 180.0f;
-		pid.Update(rotation[axis] / 180.0f, deltaSeconds);
+		pid.target = target[axis];
+		pid.Update(input[axis], deltaSeconds);
 	}
 
-	UpdateMotorsRelative();
+	activeControllers = controllers;
+
+	if (autotuneAxis == NO_AXIS)
+		return;
+
+	// The relay takes over the output of the axis being tuned, as long as the same controllers are in use
+	if (autotuneControllers == controllers)
+	{
+		PidController& pid = controllers[autotuneAxis];
+		pid.output = autotune.Update(pid.target - pid.lastInput, deltaSeconds);
+	}
+	else
+		autotune.Stop();
+
+	if (!autotune.IsRunning())
+		FinishAutotune();
 }
 
-void MotorController::UpdateMotorsRelative()
-{	
-	// Base point and output multiplier for each motor is determined by throttle
+float MotorController::Throttle() const
+{
+	const FlightSystem::Setpoint& setpoint = flightSystem->CurrentSetpoint();
+
+	// Some flight modes control the throttle themselves
+	if (setpoint.throttleControl)
+		return setpoint.throttle;
+
+	return StickThrottle();
+}
+
+float MotorController::StickThrottle() const
+{
 	float throttle = receiver->NormalizedChannel(Receiver::THROTTLE);
 	throttle = (throttle + 1.0f) * 0.5f;
 
-	// Calculate outputs for each motor
-	for (uint8_t motorIdx = 0; motorIdx < Config::Constants::MC_MOTOR_AMOUNT; ++motorIdx)
-	{
-		Motor& motor = motors[motorIdx];
+	return throttleTable.Evaluate(throttle);
+}
 
-		motor.lastOutput = throttle;
+void MotorController::UpdateMotorsRelative()
+{	
+	// Base point and output multiplier for each motor is determined by throttle
+	float throttle = Throttle();
 
-		// Add the output for each axis according to the motor weight for that axis
-		for (uint8_t axis = 0; axis < 3; ++axis)
-			motor.lastOutput += pidControllers[axis].output * motor.weights[axis] * throttle;
+	// Mixer input consists of the throttle followed by the scaled output for each axis
+	float input[Mixer::INPUT_AMOUNT];
+	input[Mixer::THROTTLE] = throttle;
 
-		// Clamp within 0 ... 1 range 
-		motor.lastOutput = Util::Clamp(motor.lastOutput, 0.0f, 1.0f);
+	for (uint8_t axis = 0; axis < 3; ++axis)
+		input[Mixer::PITCH + axis] = activeControllers[axis].output * throttle;
 
-		// Convert the output to a PWM command
-		uint16_t command = config.MC_PWM_MIN_COMMAND + (config.MC_PWM_MAX_COMMAND - config.MC_PWM_MIN_COMMAND) * motor.lastOutput;
+	float outputs[Config::Constants::MC_MAX_MOTORS];
+	mixer.Mix(input, outputs);
 
-		// Write the output for this motor
-		WriteMotor(motor, command);
-	}
+	ApplyOutputs(outputs);
 }
 
 void MotorController::UpdateMotorsNormalized()
 {	
 
 	// Output multiplier for each motor is determined by throttle amount
-	float throttle = receiver->NormalizedChannel(Receiver::THROTTLE);
-	throttle = (throttle + 1.0f) * 0.5f;
+	float throttle = Throttle();
+
+	// Only mix the axis outputs, throttle is applied after normalizing
+	float input[Mixer::INPUT_AMOUNT];
+	input[Mixer::THROTTLE] = 0.0f;
+
+	for (uint8_t axis = 0; axis < 3; ++axis)
+		input[Mixer::PITCH + axis] = activeControllers[axis].output;
+
+	float outputs[Config::Constants::MC_MAX_MOTORS];
+	mixer.Mix(input, outputs);
 
-	float totalOutput = 0.0f;
 	float maxOutput = 0.0f;
 
-	// Calculate outputs for each motor
-	for (uint8_t motorIdx = 0; motorIdx < Config::Constants::MC_MOTOR_AMOUNT; ++motorIdx)
+	for (uint8_t motorIdx = 0; motorIdx < mixer.MotorAmount(); ++motorIdx)
+		maxOutput = max(maxOutput, outputs[motorIdx]);
+
+	// Normalize outputs against the maximum motor output. 
+	// This means the motor with the highest value will receive output according to the throttle value
+	// All other motor outputs are scaled accordingly
+	// NOTE: negative values here could be used as input for active brakes?
+	if (maxOutput > FLT_EPSILON)
 	{
-		Motor& motor = motors[motorIdx];
+		float scale = throttle / maxOutput;
 
-		float output = 0.0f;
+		for (uint8_t motorIdx = 0; motorIdx < mixer.MotorAmount(); ++motorIdx)
+			outputs[motorIdx] *= scale;
+	}
+	else
+	{
+		// Without any positive axis output there is nothing to normalize against, apply throttle evenly
+		for (uint8_t motorIdx = 0; motorIdx < mixer.MotorAmount(); ++motorIdx)
+			outputs[motorIdx] = throttle;
+	}
 
-		// Add the output for each axis according to the motor weight for that axis
-		for (uint8_t axis = 0; axis < 3; ++axis)
-			output += pidControllers[axis].output * motor.weights[axis];
+	ApplyOutputs(outputs);
+}
 
-		motor.lastOutput = output;
+void MotorController::UpdateMotorsDesaturated()
+{
+	float throttle = Throttle();
 
-		totalOutput += output;
-		maxOutput = max(maxOutput, output);
-	}
+	// Axis outputs are not scaled by throttle, so that full control authority remains available at low throttle
+	float input[Mixer::INPUT_AMOUNT];
+	input[Mixer::THROTTLE] = throttle;
+
+	for (uint8_t axis = 0; axis < 3; ++axis)
+		input[Mixer::PITCH + axis] = activeControllers[axis].output;
+
+	float outputs[Config::Constants::MC_MAX_MOTORS];
 
-	// Normalize and apply outputs for each motor
-	for (uint8_t motorIdx = 0; motorIdx < Config::Constants::MC_MOTOR_AMOUNT; ++motorIdx)
+	bool saturated = mixer.MixDesaturated(input, outputs);
+
+	ApplyOutputs(outputs, saturated);
+}
+
+void MotorController::ApplyOutputs(const float* outputs, bool saturated)
+{
+	for (uint8_t motorIdx = 0; motorIdx < mixer.MotorAmount(); ++motorIdx)
 	{
 		Motor& motor = motors[motorIdx];
 
-		// Normalize output against the maximum motor output. 
-		// This means the motor with the highest value will receive output according to the throttle value
-		// All other motor outputs are scaled accordingly
-		motor.lastOutput = (motor.lastOutput / maxOutput) * throttle;
-
-		// Clamp within 0 ... 1 range (Higher than 1 should not occur, TODO: test this)
-		// NOTE: negative values here could be used as input for active brakes?
-		motor.lastOutput = Util::Clamp(motor.lastOutput, 0.0f, 1.0f);
+		// Clamp within 0 ... 1 range 
+		motor.lastOutput = Util::Clamp(outputs[motorIdx], 0.0f, 1.0f);
 
-		// Convert the output to a PWM command
-		uint16_t command = config.MC_PWM_MIN_COMMAND + (config.MC_PWM_MAX_COMMAND - config.MC_PWM_MIN_COMMAND) * motor.lastOutput;
+		// Clipping a motor changes the ratios between the axis outputs just like desaturating does
+		if (motor.lastOutput != outputs[motorIdx])
+			saturated = true;
 
-		// Write the output for this motor
-		WriteMotor(motor, command);
+		// Write the output for this motor, compensated for the non-linear thrust response
+		WriteMotor(motor, OutputCommand(thrustTable.Evaluate(motor.lastOutput)));
 	}
+
+	if (saturated)
+		++mixerSaturation;
+}
+
+uint16_t MotorController::OutputCommand(float output) const
+{
+	if (protocol->digital)
+		return Dshot::ThrottleValue(output);
+
+	return config.MC_PWM_MIN_COMMAND + (config.MC_PWM_MAX_COMMAND - config.MC_PWM_MIN_COMMAND) * output;
+}
+
+uint16_t MotorController::StopCommand() const
+{
+	return protocol->digital ? Dshot::MOTOR_STOP : config.MC_PWM_MIN_OUTPUT;
 }
 
 void MotorController::Debug()
@@ -178,20 +329,97 @@ void MotorController::Debug()
 
 	for (uint8_t axis = 0; axis < 3; ++axis)
 	{
-		const PidController& pid = pidControllers[axis];
+		const PidController& pid = activeControllers[axis];
 		Debug::Print("%u: Input: %.3f; Target: %.3f; Output: %.3f; Last error: %.3f; Integrated error: %.3f;\n", 
 					  axis, pid.lastInput, pid.target, pid.output, pid.lastError, pid.integratedError);
 	}
 
 	Debug::Print("\n");
 
-	Debug::Print("Motor commands:\n");
+	Debug::Print("Motor commands (%s):\n", mixer.Name());
 
-	for (uint8_t motorIdx = 0; motorIdx < Config::Constants::MC_MOTOR_AMOUNT; ++motorIdx)
+	for (uint8_t motorIdx = 0; motorIdx < mixer.MotorAmount(); ++motorIdx)
 	{
 		const Motor& motor = motors[motorIdx];
 		Debug::Print("%u: %u\n", motorIdx, motor.lastCommand);
 	}
+
+	Debug::Print("Mixer saturation: %u\n", mixerSaturation);
+}
+
+uint16_t MotorController::SerializeResource(Page::Resource::Type type, BinaryWriteStream& stream)
+{
+	switch (type)
+	{
+		case Page::Resource::MIXER_SATURATION:
+			stream.Write(mixerSaturation);
+			return sizeof(mixerSaturation);
+
+		case Page::Resource::AUTOTUNE_STATE:
+			stream.Write(static_cast<uint8_t>(autotune.CurrentState()));
+			stream.Write(autotuneAxis);
+			stream.Write(autotune.UltimateGain());
+			stream.Write(autotune.UltimatePeriod());
+			return sizeof(uint8_t) * 2 + sizeof(float) * 2;
+	}
+
+	return 0;
+}
+
+bool MotorController::HandleCommand(Command::RequestMessage& command)
+{
+	switch (command.type)
+	{
+		case Command::START_AUTOTUNE:
+			return StartAutotune(command);
+	}
+
+	return false;
+}
+
+bool MotorController::StartAutotune(Command::RequestMessage& command)
+{
+	if (command.length < sizeof(uint8_t))
+		return false;
+
+	uint8_t axis = command.buffer.readStream.ReadByte();
+
+	// Identification needs the craft to be airborne and the axis to be controlled
+	if (!armed || axis >= 3 || !activeControllers[axis].enabled || autotune.IsRunning())
+		return false;
+
+	// Tune the controllers of the current flight mode
+	autotuneAxis = axis;
+	autotuneControllers = activeControllers;
+	autotune.Start(AUTOTUNE_AMPLITUDE, AUTOTUNE_HYSTERESIS, AUTOTUNE_TIMEOUT);
+
+	Debug::Print("Autotune started on axis %u\n", axis);
+
+	return true;
+}
+
+void MotorController::FinishAutotune()
+{
+	if (autotune.CurrentState() == RelayAutotune::FINISHED)
+	{
+		Config::PidConfiguration configuration(autotune.Kp(), autotune.Ki(), autotune.Kd());
+
+		Debug::Print("Autotune finished on axis %u: Ku: %.3f; Tu: %.3f; P: %.3f; I: %.3f; D: %.3f;\n", autotuneAxis, 
+					 autotune.UltimateGain(), autotune.UltimatePeriod(), configuration.kp, configuration.ki, configuration.kd);
+
+		// The host persists the result by saving the config
+		if (autotuneControllers == rateControllers)
+			Config::Instance().SetRatePidConfiguration(autotuneAxis, configuration);
+		else
+			Config::Instance().SetPidConfiguration(autotuneAxis, configuration);
+	}
+	else
+		Debug::Print("Autotune aborted on axis %u\n", autotuneAxis);
+
+	// Start the axis without integrated error from before the relay took over
+	autotuneControllers[autotuneAxis].Reset();
+
+	autotuneAxis = NO_AXIS;
 }
 
 void MotorController::SetArmState(bool state)
@@ -199,10 +427,23 @@ void MotorController::SetArmState(bool state)
 	if (state == armed)
 		return;
 
+	if (state && receiver->Failsafe() != Receiver::FAILSAFE_NONE)
+	{
+		Debug::Print("Can't arm without a receiver link\n");
+		return;
+	}
+
 	armed = state;
 
 	if (!armed)
 	{
+		// Disarming aborts autotuning
+		if (autotuneAxis != NO_AXIS)
+		{
+			autotune.Stop();
+			autotuneAxis = NO_AXIS;
+		}
+
 		DisableMotors();
 		ResetControllers();
 		Debug::Print("Motors disarmed!\n");
@@ -214,11 +455,13 @@ void MotorController::SetArmState(bool state)
 void MotorController::DisableMotors()
 {
 	// Write minimum commands to all motors
-	for (uint8_t motorIdx = 0; motorIdx < Config::Constants::MC_MOTOR_AMOUNT; ++motorIdx)
+	for (uint8_t motorIdx = 0; motorIdx < mixer.MotorAmount(); ++motorIdx)
 	{
 		Motor& motor = motors[motorIdx];
-		WriteMotor(motor, config.MC_PWM_MIN_OUTPUT);
+		WriteMotor(motor, StopCommand());
 	}
+
+	FlushMotors();
 }
 
 void MotorController::ResetControllers()
@@ -226,8 +469,8 @@ void MotorController::ResetControllers()
 	// Reset all PID controllers
 	for (uint8_t axis = 0; axis < 3; ++axis)
 	{
-		PidController& pid = pidControllers[axis];
-		pid.Reset();
+		pidControllers[axis].Reset();
+		rateControllers[axis].Reset();
 	}
 }
 
@@ -236,47 +479,206 @@ void MotorController::WriteMotor(Motor& motor, uint16_t command)
 	if (!motor.enabled)
 		return;
 
+	if (protocol->digital)
+	{
+		// Frames are written for all motors at once when flushing
+		if (command > Dshot::MAX_THROTTLE)
+			command = Dshot::MAX_THROTTLE;
+
+		motor.lastCommand = command;
+		return;
+	}
+
 	motor.lastCommand = Util::Clamp(command, config.MC_PWM_MIN_OUTPUT, config.MC_PWM_MAX_COMMAND);
-	WritePwm(motor.pin, motor.lastCommand);
+	WritePwm(*motor.output, motor.lastCommand);
+}
+
+void MotorController::FlushMotors()
+{
+	if (protocol->digital)
+	{
+		WriteFrames();
+		return;
+	}
+
+	// Let all channels pick up their new duty cycle at the start of the next period
+	PWMC_SetSyncChannelUpdateUnlock(PWM_INTERFACE);
+}
+
+void MotorController::SetProtocol(uint8_t protocol)
+{
+	if (protocol >= LAST_OUTPUT_PROTOCOL)
+	{
+		Debug::Print("Invalid output protocol %u, using PWM\n", protocol);
+		protocol = PROTOCOL_PWM;
+	}
+
+	this->protocol = &PROTOCOLS[protocol];
+
+	// Convert nanoseconds to clock ticks
+	uint32_t ticksPerMicrosecond = this->protocol->clock / 1000000;
+
+	periodTicks 	= (this->protocol->period * ticksPerMicrosecond) / 1000;
+	minPulseTicks 	= (this->protocol->minPulse * ticksPerMicrosecond) / 1000;
+	pulseRangeTicks = ((this->protocol->maxPulse - this->protocol->minPulse) * ticksPerMicrosecond) / 1000;
 }
 
 void MotorController::EnablePWM()
 {
-	Debug::Print("Enabling PWM periphial...\n");
+	Debug::Print("Enabling PWM periphial for %s output...\n", protocol->name);
 
     pmc_enable_periph_clk(PWM_INTERFACE_ID);
-    PWMC_ConfigureClocks(config.MC_PWM_FREQUENCY * config.MC_PWM_PERIOD, 0, VARIANT_MCK);
+    PWMC_ConfigureClocks(protocol->clock, 0, VARIANT_MCK);
+
+	// All motor channels are grouped as synchronous channels, so that new commands are applied to all motors in the same period.
+	// Channel 0 provides the counter for all synchronous channels so it is always part of the group
+	syncChannels = 1;
+
+	for (uint8_t motorIdx = 0; motorIdx < mixer.MotorAmount(); ++motorIdx)
+		syncChannels |= 1 << motors[motorIdx].output->channel;
+
+	syncChannelAmount = 0;
+
+	for (uint8_t channel = 0; channel < Config::Constants::MC_MAX_MOTORS; ++channel)
+		syncChannelAmount += (syncChannels >> channel) & 1;
+
+	if (protocol->digital)
+	{
+		// Digital frames are written by the PDC, which updates the duty cycles of all synchronous channels every period
+		PWMC_ConfigureSyncChannel(PWM_INTERFACE, syncChannels, PWM_SCM_UPDM_MODE2, 0, 0);
+		PWMC_SetSyncChannelUpdatePeriod(PWM_INTERFACE, 0);
+	}
+	else
+	{
+		// Duty cycles are written to the update registers and applied together when the update is unlocked
+		PWMC_ConfigureSyncChannel(PWM_INTERFACE, syncChannels, PWM_SCM_UPDM_MODE0, 0, 0);
+	}
+
+	ConfigureChannel(0);
+
+	if (protocol->digital)
+	{
+		// Keep all lines low until the first frame is written
+		for (uint32_t idx = 0; idx < sizeof(frameBuffer) / sizeof(frameBuffer[0]); ++idx)
+			frameBuffer[idx] = 0;
+
+		PWM_INTERFACE->PWM_PTCR = PWM_PTCR_TXTEN;
+	}
 }
 
-void MotorController::EnablePin(uint8_t pin)
+void MotorController::ConfigureChannel(uint32_t channel)
 {
-	const PinDescription& desc = g_APinDescription[pin];
-    uint32_t channel = desc.ulPWMChannel;
-
-    // Make sure this is a PWM pin
-    assert((desc.ulPinAttribute & PIN_ATTR_PWM) == PIN_ATTR_PWM);
-	
 	// Disable the channel so we can directly write to the registers
 	PWMC_DisableChannel(PWM_INTERFACE, channel);
 	while ((PWM_INTERFACE->PWM_SR & (1 << channel)) != 0);	// Wait for the channel to be disabled
 
-	PIO_Configure(desc.pPort, desc.ulPinType, desc.ulPin, desc.ulPinConfiguration);
-
-	// Configure channel for our frequencies
+	// Configure channel for the protocol's frequencies
+	// The duty cycle is the high time at the start of the period, so each DShot bit starts with its high time on the bit clock
 	PWMC_ConfigureChannel(PWM_INTERFACE, channel, PWM_CMR_CPRE_CLKA, 0, 0);
-	PWMC_SetPeriod(PWM_INTERFACE, channel, config.MC_PWM_PERIOD);
+	PWMC_SetPeriod(PWM_INTERFACE, channel, periodTicks);
 	PWMC_SetDutyCycle(PWM_INTERFACE, channel, 0);
+}
+
+void MotorController::EnableOutput(const PwmOutput& output)
+{
+	ConfigureChannel(output.channel);
+
+	PIO_Configure(output.port, PIO_PERIPH_B, output.mask, PIO_DEFAULT);
+
+	Debug::Print("Motor on pin %u enabled\n", output.pin);
+}
+
+void MotorController::EnableChannels()
+{
+	// Enabling channel 0 starts all synchronous channels together
+	PWM_INTERFACE->PWM_ENA = syncChannels;
+}
+
+void MotorController::WritePwm(const PwmOutput& output, uint16_t command)
+{
+	// Scale the command from standard PWM pulse length (1000 ... 2000 us) to the pulse length of the protocol
+	int32_t dutyCycle = minPulseTicks + ((static_cast<int32_t>(command) - 1000) * pulseRangeTicks) / 1000;
+	dutyCycle = Util::Clamp(dutyCycle, static_cast<int32_t>(0), static_cast<int32_t>(periodTicks));
 
-	// Enable the channel again
-	PWMC_EnableChannel(PWM_INTERFACE, channel);
+	// Only write the update register, the new duty cycle takes effect once all motors are flushed
+	PWM_INTERFACE->PWM_CH_NUM[output.channel].PWM_CDTYUPD = dutyCycle;
+}
+
+void MotorController::WriteFrames()
+{
+	// Skip this update if the PDC is still transferring the previous frames
+	if (PWM_INTERFACE->PWM_TCR != 0)
+		return;
+
+	// High time of each bit type
+	uint16_t one = minPulseTicks + pulseRangeTicks;
+	uint16_t zero = minPulseTicks;
+
+	for (uint8_t motorIdx = 0; motorIdx < mixer.MotorAmount(); ++motorIdx)
+	{
+		const Motor& motor = motors[motorIdx];
+		uint32_t channel = motor.output->channel;
 
-	Debug::Print("Motor on pin %u enabled\n", pin);
+		// Values for the synchronous channels are ordered by channel number
+		uint8_t slot = 0;
+
+		for (uint8_t lowerChannel = 0; lowerChannel < channel; ++lowerChannel)
+			slot += (syncChannels >> lowerChannel) & 1;
+
+		Dshot::EncodeBits(Dshot::EncodeFrame(motor.lastCommand), frameBuffer + slot, syncChannelAmount, one, zero);
+	}
+
+	// Start the transfer of all bits followed by the low slot
+	PWM_INTERFACE->PWM_TPR = reinterpret_cast<uint32_t>(frameBuffer);
+	PWM_INTERFACE->PWM_TCR = (Dshot::FRAME_BITS + 1) * syncChannelAmount;
 }
 
-void MotorController::WritePwm(uint8_t pin, uint16_t dutyCycle)
+float MotorController::ThrustLinearization::operator()(float thrust) const
 {
-	const PinDescription& desc = g_APinDescription[pin];
-	PWMC_SetDutyCycle(PWM_INTERFACE, desc.ulPWMChannel, dutyCycle);
+	if (amount < FLT_EPSILON)
+		return thrust;
+
+	// Solve thrust = (1 - amount) * output + amount * output^2 for the output
+	float linear = 1.0f - amount;
+	return (sqrt(linear * linear + 4.0f * amount * thrust) - linear) / (2.0f * amount);
+}
+
+float MotorController::ThrottleCurve::operator()(float throttle) const
+{
+	float offset = throttle - mid;
+	float range = offset > 0.0f ? 1.0f - mid : mid;
+
+	if (range < FLT_EPSILON)
+		return throttle;
+
+	float relative = offset / range;
+
+	return mid + offset * (1.0f - expo + expo * relative * relative);
+}
+
+MotorController::GainSchedule::GainSchedule(const Config& config, float Config::PidConfiguration::* gain) : 
+	breakpoints(config.MC_GAIN_SCHEDULE), gain(gain), tpaBreakpoint(config.MC_TPA_BREAKPOINT), tpaRate(config.MC_TPA_RATE)
+{
+
+}
+
+float MotorController::GainSchedule::operator()(float throttle) const
+{
+	// Interpolate between the two breakpoints surrounding the throttle
+	float position = throttle * (Config::Constants::MC_GAIN_BREAKPOINTS - 1);
+
+	uint8_t idx = static_cast<uint8_t>(position);
+	if (idx > Config::Constants::MC_GAIN_BREAKPOINTS - 2)
+		idx = Config::Constants::MC_GAIN_BREAKPOINTS - 2;
+
+	float t = position - idx;
+	float multiplier = breakpoints[idx].*gain + (breakpoints[idx + 1].*gain - breakpoints[idx].*gain) * t;
+
+	// TPA only attenuates P and D, linearly from the breakpoint to full throttle
+	if (gain != &Config::PidConfiguration::ki && throttle > tpaBreakpoint && tpaBreakpoint < 1.0f)
+		multiplier *= 1.0f - tpaRate * (throttle - tpaBreakpoint) / (1.0f - tpaBreakpoint);
+
+	return multiplier;
 }
 
 MotorController::PidController::PidController() : enabled(true), kp(1.0f), ki(1.0f), kd(1.0f), 
@@ -287,11 +689,20 @@ MotorController::PidController::PidController() : enabled(true), kp(1.0f), ki(1.
 
 void MotorController::PidController::Configure(Config::PidConfiguration configuration)
 {
+	this->configuration = configuration;
+
 	kp = configuration.kp;
 	ki = configuration.ki;
 	kd = configuration.kd;
 }
 
+void MotorController::PidController::Schedule(float kpScale, float kiScale, float kdScale)
+{
+	kp = configuration.kp * kpScale;
+	ki = configuration.ki * kiScale;
+	kd = configuration.kd * kdScale;
+}
+
 void MotorController::PidController::Update(float input, float dt)
 {
 	if (!enabled)
@@ -308,6 +719,20 @@ void MotorController::PidController::Update(float input, float dt)
 	lastInput = input;
 }
 
+void MotorController::PidController::Handover(float output, float input)
+{
+	if (!enabled)
+		return;
+
+	// Let the integrator carry the previous output, and start the derivative from the current input
+	integratedError = ki > FLT_EPSILON ? output / ki : 0.0f;
+
+	lastError = 0.0f;
+	lastInput = input;
+
+	this->output = output;
+}
+
 void MotorController::PidController::Reset()
 {
 	integratedError = 0.0f;
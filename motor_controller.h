@@ -5,6 +5,10 @@
 #include "bothezat.h"
 
 #include "module.h"
+#include "mixer.h"
+#include "dshot.h"
+#include "lookup_table.h"
+#include "relay_autotune.h"
 
 namespace bothezat
 {
@@ -13,32 +17,129 @@ class MotionSensor;
 class Receiver;
 class FlightSystem;
 
-class MotorController : public Module<MotorController>
+class MotorController : public Module<MotorController>, public ResourceProvider, public CommandHandler
 {
 friend class Module<MotorController>;
 
 public:
+	enum MixerMode
+	{
+		// Axis outputs are scaled by throttle and each motor is clamped individually
+		MIXER_RELATIVE = 0,
+
+		// Axis outputs are normalized against the highest motor output and scaled by throttle
+		MIXER_NORMALIZED,
+
+		// Axis outputs are applied at full authority, all motors are scaled and shifted together to fit the output range
+		MIXER_DESATURATED,
+
+		LAST_MIXER_MODE
+	};
+
+	enum OutputProtocol
+	{
+		// Standard servo PWM at 490 Hz
+		PROTOCOL_PWM = 0,
+
+		// 125 ... 250 us pulses
+		PROTOCOL_ONESHOT125,
+
+		// 5 ... 25 us pulses
+		PROTOCOL_MULTISHOT,
+
+		// Digital protocols at 150, 300 and 600 kbit/s
+		PROTOCOL_DSHOT150,
+		PROTOCOL_DSHOT300,
+		PROTOCOL_DSHOT600,
+
+		LAST_OUTPUT_PROTOCOL
+	};
+
+	struct ProtocolDescription
+	{
+		const char* name;
+
+		// Frequency the PWM channels are clocked at, in Hz. Should be a multiple of 1 MHz
+		uint32_t clock;
+
+		// Time between the start of two pulses, in ns. For digital protocols this is the length of a bit
+		uint32_t period;
+
+		// Pulse length for the minimum and maximum command, in ns. For digital protocols these are the high times of a zero and a one bit
+		uint32_t minPulse, maxPulse;
+
+		// Digital protocols send DShot frames through the PDC instead of a continuous pulse
+		bool digital;
+	};
+
+	// Descriptor for a PWM periphial output that a motor can be connected to
+	struct PwmOutput
+	{
+		uint8_t pin;
+		uint8_t channel;
+
+		Pio* port;
+		uint32_t mask;
+	};
+
 	struct Motor
 	{
 		bool enabled;
-		uint8_t pin;
+
+		const PwmOutput* output;
 
 		float lastOutput;
 		uint16_t lastCommand;
 
-		Vector3 weights;
-
-		Motor() : enabled(true), lastOutput(0.0f), lastCommand(0), weights(0.0f, 0.0f, 0.0f)
+		Motor() : enabled(false), output(NULL), lastOutput(0.0f), lastCommand(0)
 		{
 
 		}
 	};
 
+	// Inverse of a thrust response that is partly quadratic in the motor output
+	struct ThrustLinearization
+	{
+		float amount;
+
+		ThrustLinearization(float amount) : amount(amount) { }
+
+		float operator()(float thrust) const;
+	};
+
+	// Throttle expo curve around a mid point
+	struct ThrottleCurve
+	{
+		float mid, expo;
+
+		ThrottleCurve(float mid, float expo) : mid(mid), expo(expo) { }
+
+		float operator()(float throttle) const;
+	};
+
+	// Multiplier for one of the PID gains, interpolated from the gain schedule and attenuated by TPA
+	struct GainSchedule
+	{
+		const Config::PidConfiguration* breakpoints;
+
+		// The gain of the PID configuration this schedule is for
+		float Config::PidConfiguration::* gain;
+
+		float tpaBreakpoint, tpaRate;
+
+		GainSchedule(const Config& config, float Config::PidConfiguration::* gain);
+
+		float operator()(float throttle) const;
+	};
+
 	struct PidController
 	{
 		bool enabled;
 
-		// PID coëfficients
+		// Configured PID coëfficients
+		Config::PidConfiguration configuration;
+
+		// PID coëfficients currently in use
 		float kp;
 		float ki;
 		float kd;
@@ -54,24 +155,88 @@ public:
 
 		void Configure(Config::PidConfiguration configuration);
 
+		// Sets the coëfficients in use to the configured ones multiplied by the given factors
+		void Schedule(float kpScale, float kiScale, float kdScale);
+
+		// Takes over control from another controller, continuing its output without a step
+		void Handover(float output, float input);
+
 		void Update(float input, float dt);
 
 		void Reset();
 		
 	};
 
+	static const uint8_t CURVE_SIZE = 33;
+
+	// Relay output and hysteresis (in normalized angle) used for autotuning, and the time after which it is aborted (s)
+	static const float AUTOTUNE_AMPLITUDE = 0.1f;
+	static const float AUTOTUNE_HYSTERESIS = 0.002f;
+	static const float AUTOTUNE_TIMEOUT = 20.0f;
+
+	static const uint8_t NO_AXIS = 0xFF;
+
+	// Angular velocity (deg/s) that is normalized to one for the rate controllers
+	static const float RATE_RANGE = 500.0f;
+
 private:
-	Motor motors[Config::Constants::MC_MOTOR_AMOUNT];
+	// Outputs used for each motor index of the mixer
+	static const PwmOutput PWM_OUTPUTS[Config::Constants::MC_MAX_MOTORS];
+
+	static const ProtocolDescription PROTOCOLS[LAST_OUTPUT_PROTOCOL];
+
+	const ProtocolDescription* protocol;
+
+	// Protocol timings converted to PWM clock ticks
+	uint16_t periodTicks, minPulseTicks, pulseRangeTicks;
+
+	// Channels that are part of the synchronous channel group
+	uint32_t syncChannels;
+	uint8_t syncChannelAmount;
+
+	// Duty cycle values transferred by the PDC for digital protocols. 
+	// Holds a value for each synchronous channel per bit, followed by a slot that keeps the lines low between frames
+	uint16_t frameBuffer[(Dshot::FRAME_BITS + 1) * Config::Constants::MC_MAX_MOTORS];
+
+	Motor motors[Config::Constants::MC_MAX_MOTORS];
+
+	Mixer mixer;
+
+	// Maps desired thrust to motor output
+	LookupTable<CURVE_SIZE> thrustTable;
+
+	// Maps throttle stick position to throttle
+	LookupTable<CURVE_SIZE> throttleTable;
+
+	// Map throttle to multipliers for each PID gain
+	LookupTable<CURVE_SIZE> kpTable, kiTable, kdTable;
+
+	// The config revision the tables were last generated for
+	uint32_t configRevision;
 
 	// PID values for all axes
 	PidController pidControllers[3];
 
+	// PID values for the angular velocity of all axes
+	PidController rateControllers[3];
+
+	// Either the angle or the rate controllers, depending on the control type of the flight mode
+	PidController* activeControllers;
+
+	// Relay feedback identification, replaces the PID controller of a single axis while running
+	RelayAutotune autotune;
+	uint8_t autotuneAxis;
+	PidController* autotuneControllers;
+
 	MotionSensor* motionSensor;
 	Receiver* receiver;
 	FlightSystem* flightSystem;	
 
 	bool armed;
 
+	// Amount of control loops in which the mixer output had to be altered or clipped to fit the motor output range
+	uint32_t mixerSaturation;
+
 protected:
 	MotorController();
 
@@ -82,6 +247,10 @@ public:
 
 	virtual void Debug();
 
+	virtual uint16_t SerializeResource(Page::Resource::Type type, BinaryWriteStream& stream);
+
+	virtual bool HandleCommand(Command::RequestMessage& command);
+
 	void SetArmState(bool state);
 
 	void DisableMotors();
@@ -89,15 +258,39 @@ public:
 
 	bool IsArmed() const { return armed; }
 
+	// Throttle stick position with the throttle curve applied, in the 0 ... 1 range
+	float StickThrottle() const;
+
 private:
+	void ApplyConfig();
+
+	float Throttle() const;
+
+	void UpdateControllers(uint32_t dt);
+
+	bool StartAutotune(Command::RequestMessage& command);
+	void FinishAutotune();
+
 	void UpdateMotorsRelative();
 	void UpdateMotorsNormalized();
+	void UpdateMotorsDesaturated();
+
+	// Clamps and writes the motor outputs, counts the loop in mixerSaturation if the mixer was saturated or a motor is clipped
+	void ApplyOutputs(const float* outputs, bool saturated = false);
+
+	uint16_t OutputCommand(float output) const;
+	uint16_t StopCommand() const;
 
 	void WriteMotor(Motor& motor, uint16_t commmand);
+	void FlushMotors();
 
 	void EnablePWM();
-	void EnablePin(uint8_t pin);
-	void WritePwm(uint8_t pin, uint16_t dutyCycle);
+	void SetProtocol(uint8_t protocol);
+	void ConfigureChannel(uint32_t channel);
+	void EnableOutput(const PwmOutput& output);
+	void EnableChannels();
+	void WritePwm(const PwmOutput& output, uint16_t command);
+	void WriteFrames();
 
 };
 
@@ -0,0 +1,114 @@
+#ifndef _MS5611_H_
+#define _MS5611_H_
+
+#include <stdint.h>
+
+// MS5611-01BA03 barometric pressure sensor
+// ----------------------------------------
+//
+// Documentation:
+//  - "MS5611-01BA03 Barometric Pressure Sensor" datasheet
+//
+// The sensor has no registers, it is controlled with single byte commands.
+// Pressure (D1) and temperature (D2) are converted separately, after which
+// the 24 bit result can be read with the ADC read command.
+
+#define MS5611_I2C_ADDRESS			0x77	// CSB pin low, 0x76 when high
+
+#define MS5611_RESET				0x1E
+#define MS5611_CONVERT_D1			0x40	// Add the OSR command offset
+#define MS5611_CONVERT_D2			0x50	// Add the OSR command offset
+#define MS5611_ADC_READ				0x00
+#define MS5611_PROM_READ			0xA0	// Add 2 * the PROM address (0 ... 7)
+
+#define MS5611_OSR_256				0x00
+#define MS5611_OSR_512				0x02
+#define MS5611_OSR_1024				0x04
+#define MS5611_OSR_2048				0x06
+#define MS5611_OSR_4096				0x08
+
+// Maximum conversion times (us) for each OSR
+#define MS5611_CONVERSION_256		600
+#define MS5611_CONVERSION_512		1170
+#define MS5611_CONVERSION_1024		2280
+#define MS5611_CONVERSION_2048		4540
+#define MS5611_CONVERSION_4096		9040
+
+#define MS5611_RESET_TIME			2800
+
+#define MS5611_PROM_SIZE			8
+
+namespace bothezat
+{
+
+/*
+ *	Conversion of raw MS5611 samples to temperature and pressure. Has no hardware dependencies so it can also be compiled on a host.
+ */
+struct MS5611
+{
+	// Calculates temperature (0.01 degC) and pressure (Pa) from raw samples using the factory calibration in the PROM.
+	// Includes the second order temperature compensation for temperatures below 20 degC
+	static void Compensate(const uint16_t* prom, uint32_t d1, uint32_t d2, int32_t& temperature, int32_t& pressure)
+	{
+		int32_t dT = (int32_t) d2 - ((int32_t) prom[5] << 8);
+		int32_t temp = 2000 + (int32_t) (((int64_t) dT * prom[6]) >> 23);
+
+		int64_t off = ((int64_t) prom[2] << 16) + (((int64_t) prom[4] * dT) >> 7);
+		int64_t sens = ((int64_t) prom[1] << 15) + (((int64_t) prom[3] * dT) >> 8);
+
+		if (temp < 2000)
+		{
+			int64_t low = (int64_t) (temp - 2000) * (temp - 2000);
+
+			int32_t t2 = (int32_t) (((int64_t) dT * dT) >> 31);
+			int64_t off2 = 5 * low / 2;
+			int64_t sens2 = 5 * low / 4;
+
+			if (temp < -1500)
+			{
+				int64_t veryLow = (int64_t) (temp + 1500) * (temp + 1500);
+
+				off2 += 7 * veryLow;
+				sens2 += 11 * veryLow / 2;
+			}
+
+			temp -= t2;
+			off -= off2;
+			sens -= sens2;
+		}
+
+		temperature = temp;
+		pressure = (int32_t) (((((int64_t) d1 * sens) >> 21) - off) >> 15);
+	}
+
+	// Checks the 4 bit CRC stored in the lowest bits of the last PROM word
+	static bool CheckCRC(const uint16_t* prom)
+	{
+		uint16_t remainder = 0;
+
+		for (uint8_t idx = 0; idx < MS5611_PROM_SIZE * 2; ++idx)
+		{
+			uint16_t word = prom[idx >> 1];
+
+			// The CRC itself is not part of the calculation
+			if (idx == MS5611_PROM_SIZE * 2 - 1)
+				word &= 0xFF00;
+
+			remainder ^= (idx & 1) ? (word & 0x00FF) : (word >> 8);
+
+			for (uint8_t bit = 0; bit < 8; ++bit)
+			{
+				if (remainder & 0x8000)
+					remainder = (remainder << 1) ^ 0x3000;
+				else
+					remainder <<= 1;
+			}
+		}
+
+		return ((remainder >> 12) & 0x0F) == (prom[7] & 0x0F);
+	}
+};
+
+}
+
+#endif
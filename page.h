@@ -10,6 +10,8 @@ struct Page
 {
 	static const uint32_t MAX_RESOURCES_PER_PAGE = 32;
 
+	static const uint32_t MAX_SUBSCRIPTIONS = 16;
+
 	struct Resource : public Serializable
 	{
 		enum Type
@@ -22,6 +24,7 @@ struct Page
 			ACCEL_ORIENTATION 		= 0x11,
             ACCELERATION            = 0x15,
             ANGULAR_VELOCITY        = 0x16,
+            ALTITUDE                = 0x17,
 
             // Motor controller
             YAW_PID                 = 0x20,
@@ -31,11 +34,14 @@ struct Page
             PITCH_PID_DEBUG         = 0x24,
             ROLL_PID_DEBUG          = 0x25,
             MOTOR_OUTPUT 			= 0x26,
+            MIXER_SATURATION 		= 0x27,
+            AUTOTUNE_STATE 			= 0x28,
 
             // Receiver
             RECEIVER_CHANNELS		= 0x30,
             RECEIVER_NORMALIZED 	= 0x31,
             RECEIVER_CONNECTED 		= 0x32,
+            RECEIVER_STATS 			= 0x33,
 
 			INVALID_RESOURCE 		= 0xFF,
 		};
@@ -116,6 +122,62 @@ struct Page
 		}
 	};
 
+	// Resource the host wants to receive periodically, without requesting it each time
+	struct Subscription
+	{
+		Resource::Type type;
+
+		// Pushes per second
+		uint16_t rate;
+	};
+
+	// Replaces all subscriptions, an empty request cancels them
+	struct SubscriptionRequestMessage : public Deserializable
+	{
+		uint32_t numSubscriptions;
+
+		Subscription subscriptions[MAX_SUBSCRIPTIONS];
+
+		bool Deserialize(BinaryReadStream& stream)
+		{
+			if (stream.Available() < sizeof(numSubscriptions))
+				return false;
+
+			numSubscriptions = stream.ReadUInt32();
+
+			if (numSubscriptions > MAX_SUBSCRIPTIONS)
+				return false;
+
+			// Each subscription is a resource type followed by its rate
+			if (stream.Available() < numSubscriptions * (sizeof(uint8_t) + sizeof(uint16_t)))
+				return false;
+
+			for (uint32_t subscriptionIdx = 0; subscriptionIdx < numSubscriptions; ++subscriptionIdx)
+			{
+				subscriptions[subscriptionIdx].type = static_cast<Resource::Type>(stream.ReadByte());
+				subscriptions[subscriptionIdx].rate = stream.ReadUInt16();
+			}
+
+			return true;
+		}
+	};
+
+	struct SubscriptionResponseMessage : public Serializable
+	{
+		// Amount of subscriptions that were accepted, subscriptions to unknown resources or without a rate are dropped
+		uint32_t numSubscriptions;
+
+		void Serialize(BinaryWriteStream& stream) const
+		{
+			stream.Write(numSubscriptions);
+		}
+
+		uint32_t SerializedSize() const
+		{
+			return sizeof(numSubscriptions);
+		}
+	};
+
 };
 
 class ResourceProvider
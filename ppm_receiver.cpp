@@ -0,0 +1,100 @@
+#include "Arduino.h"
+#include "bothezat.h"
+
+#include "ppm_receiver.h"
+#include "timer.h"
+
+using namespace bothezat;
+
+PpmReceiver::PpmReceiver() : Receiver(), timer(NULL), lastCapture(0), channelIdx(0), frameChannels(0), frameReady(false), timeSinceFrame(0)
+{
+
+}
+
+void PpmReceiver::Setup()
+{
+	// The pin is connected to TIOA0, which is the capture input of timer 0 channel 0
+	const PinDescription& desc = g_APinDescription[Config::Pins::RX_PPM];
+	PIO_Configure(desc.pPort, desc.ulPinType, desc.ulPin, desc.ulPinConfiguration);
+
+	// Capture the counter in RA on every rising edge
+	timer = Timer::GetTimer(TC0, 0);
+	uint16_t precision = timer->SetPrecision(100, TC_CMR_LDRA_RISING);
+
+	Debug::Print("PPM receiver timer set to %d ns precision\n", precision);
+
+	timer->SetInterruptHandler(&PpmReceiver::HandleCapture);
+	timer->EnableInterrupts(TC_IER_LDRAS);
+	timer->Start();
+}
+
+void PpmReceiver::Loop(uint32_t dt)
+{
+	Receiver::Loop(dt);
+
+	timeSinceFrame += dt;
+
+	if (!frameReady)
+	{
+		if (timeSinceFrame > FRAME_TIMEOUT)
+			SetConnected(false);
+
+		return;
+	}
+
+	uint16_t channels[Config::Constants::RX_MAX_CHANNELS];		// Pulse length for each channel
+
+	// Initialize all channels to the mid level, in case the frame has less channels
+	for (uint8_t channel = 0; channel < Config::Constants::RX_MAX_CHANNELS; ++channel)
+		channels[channel] = config.RX_CHANNEL_CALIBRATION[channel].mid;
+
+	// Copy the frame without the interrupt replacing it halfway
+	noInterrupts();
+
+	for (uint8_t channel = 0; channel < frameChannels; ++channel)
+		channels[channel] = frame[channel];
+
+	frameReady = false;
+
+	interrupts();
+
+	timeSinceFrame = 0;
+	SetConnected(true);
+
+	// Save new pulse lengths
+	UpdateChannels(channels);
+}
+
+void PpmReceiver::HandleISR(uint32_t status)
+{
+	if ((status & TC_SR_LDRAS) == 0)
+		return;
+
+	uint32_t capture = timer->ReadCaptureA();
+
+	// Unsigned subtraction also gives the right result when the counter wrapped
+	uint32_t length = timer->TicksToMicros(capture - lastCapture);
+	lastCapture = capture;
+
+	if (length > SYNC_LENGTH)
+	{
+		// Publish the frame that just ended if it is complete
+		if (channelIdx >= MIN_CHANNELS)
+		{
+			for (uint8_t channel = 0; channel < channelIdx; ++channel)
+				frame[channel] = pulses[channel];
+
+			frameChannels = channelIdx;
+			frameReady = true;
+		}
+
+		channelIdx = 0;
+	}
+	else if (channelIdx < Config::Constants::RX_MAX_CHANNELS)
+		pulses[channelIdx++] = length;
+}
+
+void PpmReceiver::HandleCapture(uint32_t status)
+{
+	PpmReceiver::Instance().HandleISR(status);
+}
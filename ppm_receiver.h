@@ -0,0 +1,65 @@
+#ifndef _PPM_RECEIVER_H_
+#define _PPM_RECEIVER_H_
+
+#include "Arduino.h"
+#include "receiver.h"
+#include "timer.h"
+
+namespace bothezat
+{
+
+/*
+ *	Class which reads a CPPM sum signal from radio receivers on a single pin.
+ *
+ *	The pin is the TIOA input of a timer channel, which captures the counter on each rising edge in hardware.
+ *	The time between two rising edges is the pulse length of a channel, a gap longer than SYNC_LENGTH ends the frame.
+ */
+class PpmReceiver : public Receiver, public Module<PpmReceiver>
+{
+friend class Module<PpmReceiver>;
+
+using Module<PpmReceiver>::config;
+
+public:
+	// Gaps between edges longer than this (us) mark the start of a new frame
+	static const uint32_t SYNC_LENGTH = 3000;
+
+	// Frames with less channels than this are discarded
+	static const uint8_t MIN_CHANNELS = 4;
+
+	// Time (us) without a complete frame after which the receiver is considered disconnected
+	static const uint32_t FRAME_TIMEOUT = 100000;
+
+private:
+	Timer* timer;
+
+	// Written from the interrupt
+	volatile uint32_t lastCapture;
+	volatile uint8_t channelIdx;
+	volatile uint16_t pulses[Config::Constants::RX_MAX_CHANNELS];
+
+	// Last complete frame, set by the interrupt and picked up in the loop
+	volatile uint16_t frame[Config::Constants::RX_MAX_CHANNELS];
+	volatile uint8_t frameChannels;
+	volatile bool frameReady;
+
+	uint32_t timeSinceFrame;
+
+protected:
+	PpmReceiver();
+
+public:
+	virtual void Setup();
+
+	virtual void Loop(uint32_t dt);
+
+	void HandleISR(uint32_t status);
+
+private:
+	static void HandleCapture(uint32_t status);
+
+};
+
+}
+
+#endif
@@ -6,7 +6,7 @@
 
 using namespace bothezat;
 
-PwmReceiver::PwmReceiver() : Receiver(), timer(NULL)
+PwmReceiver::PwmReceiver() : Receiver(), timer(NULL), pinMask(0), receivedMask(0), sequence(0), lastSequence(0), timeSinceFrame(0)
 {
 	signalPins[0] = SignalPin(48, Receiver::CHANNEL1);
 	signalPins[1] = SignalPin(49, Receiver::CHANNEL2);
@@ -14,6 +14,13 @@ PwmReceiver::PwmReceiver() : Receiver(), timer(NULL)
 	signalPins[3] = SignalPin(51, Receiver::CHANNEL4);
 	signalPins[4] = SignalPin(47, Receiver::CHANNEL5);
 	signalPins[5] = SignalPin(46, Receiver::CHANNEL6);
+
+	for (uint8_t pinIdx = 0; pinIdx < Config::Constants::RX_PWM_AMOUNT; ++pinIdx)
+	{
+		pinMask |= signalPins[pinIdx].mask;
+		pulses[pinIdx] = 0;
+		frame[pinIdx] = 0;
+	}
 }
 
 void PwmReceiver::Setup()
@@ -40,9 +47,9 @@ void PwmReceiver::Setup()
 		desc.pPort->PIO_IER = pin.mask;
 	}
 	
-	// Create a timer with a precision of at least 2 us
+	// The interrupt only reads the raw counter, the loop converts the pulse lengths to microseconds
 	timer = Timer::GetFreeTimer();
-	uint16_t precision = timer->SetPrecision(2000);
+	uint16_t precision = timer->SetPrecision(100);
 
 	Debug::Print("Receiver timer set to %d ns precision\n", precision);
 
@@ -51,32 +58,104 @@ void PwmReceiver::Setup()
 
 void PwmReceiver::Loop(uint32_t dt)
 {
+	Receiver::Loop(dt);
+
+	timeSinceFrame += dt;
+
+	uint32_t ticks[Config::Constants::RX_PWM_AMOUNT];
+
+	// Only pass on frames that weren't seen before
+	uint32_t frameSequence = ReadFrame(ticks);
+
+	if (frameSequence == lastSequence)
+	{
+		if (timeSinceFrame > FRAME_TIMEOUT)
+			SetConnected(false);
+
+		return;
+	}
+
+	lastSequence = frameSequence;
+	timeSinceFrame = 0;
+	SetConnected(true);
+
 	uint16_t channels[Config::Constants::RX_MAX_CHANNELS];		// Pulse length for each channel
 
 	// Initialize all channels to the mid level
 	for (uint8_t channel = 0; channel < Config::Constants::RX_MAX_CHANNELS; ++channel)
 		channels[channel] = config.RX_CHANNEL_CALIBRATION[channel].mid;
 
-	// Copy pulse lengths from signal pins to channel array
+	// Convert pulse lengths of the signal pins to microseconds in the channel array
 	for (uint8_t pinIdx = 0; pinIdx < Config::Constants::RX_PWM_AMOUNT; ++pinIdx)
-	{
-		const SignalPin& signalPin = signalPins[pinIdx];
-		channels[signalPin.channel] = signalPin.pulseLength;
-	}
-	
+		channels[signalPins[pinIdx].channel] = timer->TicksToMicros(ticks[pinIdx]);
+
 	// Save new pulse lengths
 	UpdateChannels(channels);
 }
 
-void PwmReceiver::HandleISR(uint32_t mask)
+uint32_t PwmReceiver::ReadFrame(uint32_t* ticks)
+{
+	uint32_t frameSequence;
+
+	// The interrupt can't be interrupted by the loop, so retrying until the sequence is unchanged gives a consistent copy
+	do
+	{
+		frameSequence = sequence;
+
+		for (uint8_t pinIdx = 0; pinIdx < Config::Constants::RX_PWM_AMOUNT; ++pinIdx)
+			ticks[pinIdx] = frame[pinIdx];
+
+	} while ((frameSequence & 1) != 0 || frameSequence != sequence);
+
+	return frameSequence;
+}
+
+void PwmReceiver::PublishFrame()
 {
-	uint32_t time = timer->Micros();
+	++sequence;
 
-	// Iterate through all signal pins the ones matching the interrupt mask
 	for (uint8_t pinIdx = 0; pinIdx < Config::Constants::RX_PWM_AMOUNT; ++pinIdx)
+		frame[pinIdx] = pulses[pinIdx];
+
+	++sequence;
+
+	receivedMask = 0;
+}
+
+void PwmReceiver::HandleISR(uint32_t mask)
+{
+	// Sample the time and all pin levels once for every pin that changed
+	uint32_t time = timer->ReadValue();
+	uint32_t levels = PIOC->PIO_PDSR;
+
+	mask &= pinMask;
+
+	for (uint8_t pinIdx = 0; mask != 0 && pinIdx < Config::Constants::RX_PWM_AMOUNT; ++pinIdx)
 	{
-		if ((mask & signalPins[pinIdx].mask) != 0)
-			signalPins[pinIdx].HandleChange(time);
+		SignalPin& signalPin = signalPins[pinIdx];
+
+		if ((mask & signalPin.mask) == 0)
+			continue;
+
+		mask &= ~signalPin.mask;
+
+		if ((levels & signalPin.mask) != 0)
+		{
+			// Start of pulse, save pulse start time
+			signalPin.pulseStart = time;
+			continue;
+		}
+
+		// End of pulse. A second pulse on the same pin means a pin stopped delivering pulses, publish what was received
+		if ((receivedMask & signalPin.mask) != 0)
+			PublishFrame();
+
+		// Unsigned subtraction also gives the right result when the counter wrapped
+		pulses[pinIdx] = time - signalPin.pulseStart;
+		receivedMask |= signalPin.mask;
+
+		if (receivedMask == pinMask)
+			PublishFrame();
 	}
 }
 
@@ -7,9 +7,14 @@
 
 namespace bothezat
 {
-	
+
 /*
  *	Class which reads PWM output from radio receivers
+ *
+ *	All signal pins are on PIOC, the interrupt samples the pin levels once and handles every changed pin by its mask.
+ *	Once every pin delivered a pulse the pulses are published as a frame, guarded by a sequence number which is odd
+ *	while the interrupt writes the frame. The loop retries the copy when the sequence changed underneath it, and only
+ *	passes the frame on when the sequence differs from the last frame it read.
  */
 class PwmReceiver : public Receiver, public Module<PwmReceiver>
 {
@@ -18,20 +23,24 @@ friend class Module<PwmReceiver>;
 using Module<PwmReceiver>::config;
 
 public:
+	// Time (us) without a new frame after which the receiver is considered disconnected
+	static const uint32_t FRAME_TIMEOUT = 100000;
+
 	// Descriptor for a pin with a pwm pulse signal
 	struct SignalPin
-	{	
+	{
 		uint16_t pin;
 		uint32_t mask;
 
 		Channel channel;
-		uint32_t pulseLength;
+
+		// Timer ticks at the rising edge
 		uint32_t pulseStart;
 
 		SignalPin() { }
 
-		SignalPin(uint16_t pin, Channel channel) : 
-				pin(pin), channel(channel), pulseLength(0), pulseStart(0)
+		SignalPin(uint16_t pin, Channel channel) :
+				pin(pin), channel(channel), pulseStart(0)
 		{
 			mask = g_APinDescription[pin].ulPin;
 		}
@@ -44,30 +53,10 @@ public:
 			pin 			= other.pin;
 			mask 			= other.mask;
 			channel 		= other.channel;
-			pulseLength 	= other.pulseLength;
 			pulseStart 		= other.pulseStart;
 
 			return *this;
 		}
-
-		void HandleChange(uint32_t time)
-		{
-			if (digitalRead(pin))
-			{
-				// Start of pulse, save pulse start time
-				pulseStart = time;
-			}
-			else
-			{
-				// End of pulse, save pulse length
-				
-				// Check for overflow
-				if (time < pulseStart)
-					pulseLength = 0xffffffff - pulseStart + time;
-				else
-					pulseLength = time - pulseStart;
-			}
-		}
 	};
 
 private:
@@ -75,6 +64,22 @@ private:
 
 	SignalPin signalPins[Config::Constants::RX_PWM_AMOUNT];
 
+	// Mask of all signal pins
+	uint32_t pinMask;
+
+	// Written from the interrupt, pulse lengths (ticks) of the frame being received and the pins that completed a pulse
+	uint32_t pulses[Config::Constants::RX_PWM_AMOUNT];
+	uint32_t receivedMask;
+
+	// Last complete frame (ticks), the sequence is odd while the interrupt writes it
+	volatile uint32_t frame[Config::Constants::RX_PWM_AMOUNT];
+	volatile uint32_t sequence;
+
+	// Sequence of the frame last passed on by the loop
+	uint32_t lastSequence;
+
+	uint32_t timeSinceFrame;
+
 protected:
 	PwmReceiver();
 
@@ -87,6 +92,12 @@ public:
 
 	void HandleISR(uint32_t mask);
 
+private:
+	void PublishFrame();
+
+	// Copies a consistent frame, returns its sequence number
+	uint32_t ReadFrame(uint32_t* ticks);
+
 };
 
 }
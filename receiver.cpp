@@ -4,27 +4,18 @@ using namespace bothezat;
 
 Receiver* Receiver::currentReceiver = NULL;
 
-Receiver::Receiver() : connected(false), config(Config::Instance())
+Receiver::Receiver() : config(Config::Instance()), connected(false), frameID(0), time(0), linkLostTime(0), linkLostAtIdle(false), failsafeStage(FAILSAFE_NONE), statistics(), windowTime(0), windowFrames(0), 
+	frameInterval(DEFAULT_FRAME_INTERVAL), lastFrameTime(0), smoothingTime(0), normalizedRevision(0), configRevision(0)
 {
 	// Iterate through channels to initialize their values
 	for (uint8_t channel = 0; channel < Config::Constants::RX_MAX_CHANNELS; ++channel)
 	{
 		channels[channel] = 0;
-		mapping[channel] = (Channel) channel;	// Default channel order matches enum order
+		channelTime[channel] = 0;
+		smoothedChannels[channel] = 0.0f;
+		smoothingSteps[channel] = 0.0f;
+		normalizedChannels[channel] = 0.0f;
 	}
-
-	// TODO: read channel mapping from config
-
-	SetSpektrumMapping();
-}
-
-void Receiver::SetSpektrumMapping()
-{		
-	// Mapping for Spektrum receivers
-	mapping[Receiver::CHANNEL1] = Receiver::THROTTLE;
-	mapping[Receiver::CHANNEL2] = Receiver::AILERON;
-	mapping[Receiver::CHANNEL3] = Receiver::ELEVATOR;
-	mapping[Receiver::CHANNEL4] = Receiver::RUDDER;
 }
 
 uint16_t Receiver::SerializeResource(Page::Resource::Type type, BinaryWriteStream& stream)
@@ -39,18 +30,141 @@ uint16_t Receiver::SerializeResource(Page::Resource::Type type, BinaryWriteStrea
 
 		case Page::Resource::RECEIVER_NORMALIZED:
 			for (uint8_t channel = 0; channel < Config::Constants::RX_MAX_CHANNELS; ++channel)
-				stream.Write(NormalizedChannel(static_cast<Channel>(channel)));
+				stream.Write(normalizedChannels[channel]);
 
 			return sizeof(float) * Config::Constants::RX_MAX_CHANNELS;
 
 		case Page::Resource::RECEIVER_CONNECTED:
 			stream.Write(connected);
-			return 1;
+			stream.Write((uint8_t) failsafeStage);
+			return 2;
+
+		case Page::Resource::RECEIVER_STATS:
+			stream.Write(statistics.frameRate);
+			stream.Write(statistics.frames);
+			stream.Write(statistics.glitches);
+			stream.Write(statistics.dropouts);
+			stream.Write(linkLostTime);
+
+			for (uint8_t channel = 0; channel < Config::Constants::RX_MAX_CHANNELS; ++channel)
+				stream.Write(ChannelAge(static_cast<Channel>(channel)));
+
+			return sizeof(uint16_t) + sizeof(uint32_t) * 4 + sizeof(uint32_t) * Config::Constants::RX_MAX_CHANNELS;
 	}
 
 	return 0;
 }
 
+void Receiver::Loop(uint32_t dt)
+{
+	time += dt;
+
+	if (configRevision != config.Revision())
+		ApplyConfig();
+
+	UpdateSmoothing(dt);
+
+	// Measure the frame rate over a fixed window
+	windowTime += dt;
+
+	if (windowTime >= STATISTICS_WINDOW)
+	{
+		statistics.frameRate = (windowFrames * 1000000) / windowTime;
+		windowFrames = 0;
+		windowTime = 0;
+	}
+
+	if (IsLinkValid())
+		linkLostTime = 0;
+	else
+	{
+		if (linkLostTime == 0)
+		{
+			// The channels still hold the last valid values
+			linkLostAtIdle = NormalizedChannel(THROTTLE) <= FAILSAFE_IDLE_THROTTLE;
+
+			// Only count losing a link that was there before
+			if (statistics.frames > 0)
+			{
+				++statistics.dropouts;
+				Debug::Print("Receiver link lost\n");
+			}
+		}
+
+		// Stay non-zero even when no time passed, and saturate instead of wrapping around to an earlier stage
+		uint32_t step = max(dt, static_cast<uint32_t>(1));
+		linkLostTime = linkLostTime + step > linkLostTime ? linkLostTime + step : 0xFFFFFFFF;
+	}
+
+	FailsafeStage stage = DetermineFailsafeStage();
+
+	if (stage != failsafeStage)
+		Debug::Print("Receiver failsafe stage %u\n", stage);
+
+	failsafeStage = stage;
+}
+
+void Receiver::UpdateSmoothing(uint32_t dt)
+{
+	if (smoothingTime == 0)
+		return;
+
+	if (dt >= smoothingTime)
+	{
+		// Land exactly on the received values
+		for (uint8_t channel = 0; channel < Config::Constants::RX_MAX_CHANNELS; ++channel)
+			smoothedChannels[channel] = channels[channel];
+
+		smoothingTime = 0;
+	}
+	else
+	{
+		for (uint8_t channel = 0; channel < Config::Constants::RX_MAX_CHANNELS; ++channel)
+			smoothedChannels[channel] += smoothingSteps[channel] * dt;
+
+		smoothingTime -= dt;
+	}
+
+	UpdateNormalizedChannels();
+}
+
+bool Receiver::IsLinkValid() const
+{
+	if (!connected)
+		return false;
+
+	// Aux channels may legitimately be missing, the sticks may not
+	return ChannelAge(THROTTLE) <= CHANNEL_TIMEOUT && ChannelAge(AILERON) <= CHANNEL_TIMEOUT && 
+		   ChannelAge(ELEVATOR) <= CHANNEL_TIMEOUT && ChannelAge(RUDDER) <= CHANNEL_TIMEOUT;
+}
+
+Receiver::FailsafeStage Receiver::DetermineFailsafeStage() const
+{
+	if (linkLostTime == 0)
+		return FAILSAFE_NONE;
+
+	float lostTime = linkLostTime * 1e-6f;
+
+	float levelStart = config.RX_FAILSAFE_HOLD_TIME;
+	float descendStart = levelStart + config.RX_FAILSAFE_LEVEL_TIME;
+	float disarmStart = descendStart + config.RX_FAILSAFE_DESCEND_TIME;
+
+	if (lostTime < levelStart)
+		return FAILSAFE_HOLD;
+
+	// Levelling at the failsafe throttle would make a craft idling on the ground take off
+	if (linkLostAtIdle)
+		return FAILSAFE_DISARM;
+
+	if (lostTime < descendStart)
+		return FAILSAFE_LEVEL;
+
+	if (lostTime < disarmStart)
+		return FAILSAFE_DESCEND;
+
+	return FAILSAFE_DISARM;
+}
+
 void Receiver::Debug() const
 {
 	Debug::Print("Channels:\n");
@@ -58,29 +172,110 @@ void Receiver::Debug() const
 	Debug::Print("%.2f;%.2f;%.2f;%.2f;%.2f;%.2f\n", NormalizedChannel(THROTTLE), NormalizedChannel(ELEVATOR), NormalizedChannel(AILERON), NormalizedChannel(RUDDER), NormalizedChannel(AUX1), NormalizedChannel(AUX2));
 }
 
-// Returns a normalized, calibrated channel in the -1.0 ... 1.0f range
-float Receiver::NormalizedChannel(Channel channel) const
+void Receiver::ApplyConfig()
 {
-	const Config::ChannelCalibration& calibration = config.RX_CHANNEL_CALIBRATION[channel];
-	int16_t offset = channels[channel] - calibration.mid;
+	for (uint8_t channel = 0; channel < Config::Constants::RX_MAX_CHANNELS; ++channel)
+	{
+		const Config::ChannelCalibration& calibration = config.RX_CHANNEL_CALIBRATION[channel];
+		const Config::ChannelMapping& mapping = config.RX_CHANNEL_MAPPING[channel];
 
-	if (abs(offset) < calibration.deadband)
-		return 0.0f;
+		// Reversal mirrors the pulse around the calibrated mid point
+		ChannelRemap& remap = channelRemaps[channel];
+		remap.source = mapping.source < Config::Constants::RX_MAX_CHANNELS ? mapping.source : channel;
+		remap.sign = mapping.reverse ? -1 : 1;
+		remap.offset = mapping.reverse ? calibration.mid * 2 : 0;
 
-	if (offset > 0)
-		return offset / (float) (calibration.max - calibration.mid);
-	else
-		return offset / (float) (calibration.mid - calibration.min);
+		// Precompute the scale of both halves of each channel, so normalizing needs no division
+		ChannelScale& scale = channelScales[channel];
+		scale.mid = calibration.mid;
+		scale.deadband = calibration.deadband;
+		scale.positive = calibration.max > calibration.mid ? 1.0f / (calibration.max - calibration.mid) : 0.0f;
+		scale.negative = calibration.mid > calibration.min ? 1.0f / (calibration.mid - calibration.min) : 0.0f;
+
+		// Rate and expo as the linear and cubic coefficient of the output
+		scale.linear = mapping.rate * (1.0f - mapping.expo);
+		scale.cubic = mapping.rate * mapping.expo;
+	}
+
+	configRevision = config.Revision();
+
+	UpdateNormalizedChannels();
+}
+
+void Receiver::UpdateNormalizedChannels()
+{
+	++normalizedRevision;
+
+	for (uint8_t channel = 0; channel < Config::Constants::RX_MAX_CHANNELS; ++channel)
+	{
+		const ChannelScale& scale = channelScales[channel];
+		float offset = smoothedChannels[channel] - scale.mid;
+
+		if (fabs(offset) < scale.deadband)
+		{
+			normalizedChannels[channel] = 0.0f;
+			continue;
+		}
+
+		float value = offset * (offset > 0.0f ? scale.positive : scale.negative);
+		normalizedChannels[channel] = value * (scale.linear + scale.cubic * value * value);
+	}
 }
 
 void Receiver::UpdateChannels(uint16_t* input)
 {
-	// Apply channel mapping by copying channels from the input 
+	// Apply channel mapping and reversal by reading each channel from its source in the input
+	for (uint8_t channel = 0; channel < Config::Constants::RX_MAX_CHANNELS; ++channel)
+	{
+		const ChannelRemap& remap = channelRemaps[channel];
+		int32_t pulse = remap.offset + remap.sign * input[remap.source];
+
+		// Invalid pulses keep the previous value, so the channel ages
+		if (IsValidPulse(static_cast<Channel>(channel), pulse))
+		{
+			channels[channel] = pulse;
+			channelTime[channel] = time;
+		}
+		else if (ChannelAge(static_cast<Channel>(channel)) <= CHANNEL_TIMEOUT)
+			++statistics.glitches;
+	}
+
+	++frameID;
+
+	++statistics.frames;
+	++windowFrames;
+
+	UpdateFrameInterval();
+
+	// Move from the current smoothed values to the new ones over the time until the next frame is expected
+	smoothingTime = config.RX_SMOOTHING ? (uint32_t) frameInterval : 0;
+
 	for (uint8_t channel = 0; channel < Config::Constants::RX_MAX_CHANNELS; ++channel)
 	{
-		uint8_t target = mapping[channel];
-		channels[target] = input[channel];
+		if (smoothingTime > 0)
+			smoothingSteps[channel] = (channels[channel] - smoothedChannels[channel]) / smoothingTime;
+		else
+			smoothedChannels[channel] = channels[channel];
 	}
+
+	UpdateNormalizedChannels();
+}
+
+void Receiver::UpdateFrameInterval()
+{
+	uint32_t interval = time - lastFrameTime;
+	lastFrameTime = time;
+
+	// Gaps in the link say nothing about the frame rate
+	if (interval > 0 && interval <= CHANNEL_TIMEOUT)
+		frameInterval += (interval - frameInterval) * FRAME_INTERVAL_FILTER;
+}
+
+bool Receiver::IsValidPulse(Channel channel, int32_t pulse) const
+{
+	const Config::ChannelCalibration& calibration = config.RX_CHANNEL_CALIBRATION[channel];
+
+	return pulse + config.RX_PULSE_MARGIN >= calibration.min && pulse <= calibration.max + config.RX_PULSE_MARGIN;
 }
 
 
@@ -16,6 +16,21 @@ namespace bothezat
 class Receiver : public ResourceProvider
 {
 public:
+	enum Type
+	{
+		// Separate PWM signal for each channel
+		RECEIVER_PWM = 0,
+
+		// CPPM sum signal on a single pin
+		RECEIVER_PPM,
+
+		// Serial receivers on USART0
+		RECEIVER_SBUS,
+		RECEIVER_SPEKTRUM,
+
+		LAST_RECEIVER_TYPE
+	};
+
 	enum Channel
 	{
 		// All available RC channels, if more should be read they need to be added below
@@ -38,12 +53,89 @@ public:
 		CHANNEL8 = AUX4
 	};
 
+	// Stages the failsafe goes through while the link stays lost, the flight system and motor controller act on these
+	enum FailsafeStage
+	{
+		// Link is fine
+		FAILSAFE_NONE = 0,
+
+		// Last valid channel values are kept
+		FAILSAFE_HOLD,
+
+		// Level at the failsafe throttle
+		FAILSAFE_LEVEL,
+
+		// Level while ramping the throttle down
+		FAILSAFE_DESCEND,
+
+		// Motors are disarmed. Follows the hold right away when the link was lost with the throttle at idle
+		FAILSAFE_DISARM
+	};
+
+	struct LinkStatistics
+	{
+		// Frames received in the last measurement window, per second
+		uint16_t frameRate;
+
+		uint32_t frames;
+
+		// Pulses outside the calibrated range on a live channel
+		uint32_t glitches;
+
+		// Times the link was lost
+		uint32_t dropouts;
+
+		LinkStatistics() : frameRate(0), frames(0), glitches(0), dropouts(0)
+		{
+
+		}
+	};
+
+	// Calibration of a channel prepared for normalizing
+	struct ChannelScale
+	{
+		float mid, deadband;
+
+		// Reciprocals of the range above and below the mid point
+		float positive, negative;
+
+		// Coefficients of the rate and expo curve
+		float linear, cubic;
+
+		ChannelScale() : mid(1500.0f), deadband(0.0f), positive(0.0f), negative(0.0f), linear(1.0f), cubic(0.0f)
+		{
+
+		}
+	};
+
+	// Channel mapping and reversal from the config, applied as pulse = offset + sign * input[source]
+	struct ChannelRemap
+	{
+		uint8_t source;
+		int32_t sign, offset;
+
+		ChannelRemap() : source(0), sign(1), offset(0)
+		{
+
+		}
+	};
+
+	// Time (us) a stick channel may go without a valid pulse before the link is considered lost
+	static const uint32_t CHANNEL_TIMEOUT = 100000;
+
+	// Normalized throttle at or below which losing the link disarms instead of levelling, so a craft idling on the ground doesn't take off
+	static const float FAILSAFE_IDLE_THROTTLE = -0.95f;
+
+	// Time (us) over which the frame rate is measured
+	static const uint32_t STATISTICS_WINDOW = 1000000;
+
+	// Frame interval (us) assumed until it is measured, and the weight of each new measurement
+	static const uint32_t DEFAULT_FRAME_INTERVAL = 20000;
+	static const float FRAME_INTERVAL_FILTER = 0.1f;
+
 	// Values of all channels as last set in UpdateChannels()
 	uint16_t channels[Config::Constants::RX_MAX_CHANNELS];
 
-	// Mapping of input signals and the way signals are saved in UpdateChannels
-	Channel mapping[Config::Constants::RX_MAX_CHANNELS];
-
 private:
 	static Receiver* currentReceiver;
 
@@ -51,15 +143,56 @@ private:
 
 	bool connected;
 
+	// Incremented every time new channel values are set
+	uint32_t frameID;
+
+	// Time (us) since setup, and the time each channel last received a valid pulse
+	uint32_t time;
+	uint32_t channelTime[Config::Constants::RX_MAX_CHANNELS];
+
+	// Time (us) since the link was lost, zero while the link is fine
+	uint32_t linkLostTime;
+
+	// Whether the throttle was at idle when the link was lost
+	bool linkLostAtIdle;
+
+	FailsafeStage failsafeStage;
+
+	LinkStatistics statistics;
+
+	uint32_t windowTime, windowFrames;
+
+	// Filtered time (us) between frames, and the time the last frame was received
+	float frameInterval;
+	uint32_t lastFrameTime;
+
+	// Channel values moving linearly towards the last received values over one frame interval
+	float smoothedChannels[Config::Constants::RX_MAX_CHANNELS];
+	float smoothingSteps[Config::Constants::RX_MAX_CHANNELS];
+
+	// Time (us) left until the smoothed values reach the received values
+	uint32_t smoothingTime;
+
+	ChannelRemap channelRemaps[Config::Constants::RX_MAX_CHANNELS];
+	ChannelScale channelScales[Config::Constants::RX_MAX_CHANNELS];
+
+	// Normalized values of the smoothed channels, updated whenever those change
+	float normalizedChannels[Config::Constants::RX_MAX_CHANNELS];
+
+	// Incremented every time the normalized channels are updated
+	uint32_t normalizedRevision;
+
+	// The config revision the remap and scale tables were last computed for
+	uint32_t configRevision;
+
 protected:
 	Receiver();
-
-	void SetSpektrumMapping();
 	
 public:
 	virtual void Setup() = 0;
 
-	virtual void Loop(uint32_t dt) = 0;
+	// Tracks the link state, derived receivers call this before reading new frames
+	virtual void Loop(uint32_t dt);
 
 	virtual void Debug() const;
 
@@ -67,8 +200,33 @@ public:
 
 	bool IsConnected() const;
 
-	// Returns a normalized, calibrated channel in the -1.0 ... 1.0f range
-	float NormalizedChannel(Channel channel) const;
+	FailsafeStage Failsafe() const { return failsafeStage; }
+
+	// Time (us) since the link was lost
+	uint32_t LinkLostTime() const { return linkLostTime; }
+
+	// Time (us) since the channel last received a valid pulse
+	uint32_t ChannelAge(Channel channel) const { return time - channelTime[channel]; }
+
+	const LinkStatistics& Statistics() const { return statistics; }
+
+	// Measured time (us) between frames
+	float FrameInterval() const { return frameInterval; }
+
+	// Whether the normalized channels still change between frames
+	bool IsSmoothing() const { return smoothingTime > 0; }
+
+	// Identifies the last set of channel values, so that derived values only need to be updated when it changes
+	uint32_t FrameID() const { return frameID; }
+
+	// Returns a normalized, calibrated channel in the -1.0 ... 1.0f range. Follows the smoothed value if RC smoothing is enabled
+	float NormalizedChannel(Channel channel) const { return normalizedChannels[channel]; }
+
+	// All normalized channels, indexed by Channel
+	const float* NormalizedChannels() const { return normalizedChannels; }
+
+	// Identifies the current normalized values, changes on new frames and while smoothing
+	uint32_t NormalizedRevision() const { return normalizedRevision; }
 
 	static void SetReceiver(Receiver& receiver) { currentReceiver = &receiver; }
 	static Receiver& CurrentReceiver() { return *currentReceiver; }
@@ -78,6 +236,20 @@ protected:
 	void UpdateChannels(uint16_t* input);
 	void SetConnected(bool connected);
 
+private:
+	bool IsValidPulse(Channel channel, int32_t pulse) const;
+
+	// Whether the connection is up and all stick channels received valid pulses recently
+	bool IsLinkValid() const;
+
+	FailsafeStage DetermineFailsafeStage() const;
+
+	void UpdateFrameInterval();
+	void UpdateSmoothing(uint32_t dt);
+
+	void ApplyConfig();
+	void UpdateNormalizedChannels();
+
 };
 
 }
@@ -0,0 +1,180 @@
+#ifndef _RELAY_AUTOTUNE_H_
+#define _RELAY_AUTOTUNE_H_
+
+#include <stdint.h>
+#include <math.h>
+
+namespace bothezat
+{
+
+/*
+ *	Relay feedback (Åström-Hägglund) identification of a single control loop.
+ *	Has no hardware dependencies so it can also be compiled on a host.
+ *
+ *	Instead of a PID controller, a relay with hysteresis drives the process. This makes it oscillate
+ *	around the setpoint at its ultimate period. From the relay amplitude d and the amplitude a of the
+ *	oscillation the ultimate gain is estimated as Ku = 4d / (pi * sqrt(a^2 - e^2)), with e the hysteresis.
+ *	PID coëfficients are then calculated with the Ziegler-Nichols rules.
+ */
+class RelayAutotune
+{
+
+public:
+	enum State
+	{
+		IDLE = 0,
+		RUNNING,
+		FINISHED,
+		FAILED
+	};
+
+	// Cycles that are ignored while the oscillation settles
+	static const uint8_t SETTLE_CYCLES = 2;
+
+	// Cycles that are averaged to estimate the ultimate gain and period
+	static const uint8_t MEASURE_CYCLES = 4;
+
+private:
+	State state;
+
+	// Relay output amplitude and hysteresis on the error
+	float amplitude, hysteresis;
+
+	// Time after which identification is aborted if the process does not oscillate
+	float timeout;
+
+	float output;
+
+	// Time since start and time of the last rising relay switch
+	float time, cycleStart;
+
+	// Error extremes within the current cycle
+	float minError, maxError;
+
+	uint8_t cycles;
+
+	// Sums of the measured periods and peak to peak amplitudes
+	float periodSum, peakSum;
+
+	float ultimateGain, ultimatePeriod;
+
+public:
+	RelayAutotune() : state(IDLE), amplitude(0.0f), hysteresis(0.0f), timeout(0.0f), output(0.0f),
+		ultimateGain(0.0f), ultimatePeriod(0.0f)
+	{
+
+	}
+
+	void Start(float amplitude, float hysteresis, float timeout)
+	{
+		this->amplitude = amplitude;
+		this->hysteresis = hysteresis;
+		this->timeout = timeout;
+
+		state = RUNNING;
+		output = amplitude;
+
+		time = 0.0f;
+		cycleStart = -1.0f;
+		minError = 0.0f;
+		maxError = 0.0f;
+
+		cycles = 0;
+		periodSum = 0.0f;
+		peakSum = 0.0f;
+	}
+
+	void Stop()
+	{
+		state = IDLE;
+		output = 0.0f;
+	}
+
+	// Advances the relay with the error (setpoint - input) of the process and returns the output to drive it with
+	float Update(float error, float dt)
+	{
+		if (state != RUNNING)
+			return 0.0f;
+
+		time += dt;
+
+		if (time > timeout)
+		{
+			state = FAILED;
+			output = 0.0f;
+
+			return output;
+		}
+
+		if (error < minError) minError = error;
+		if (error > maxError) maxError = error;
+
+		if (output > 0.0f && error < -hysteresis)
+			output = -amplitude;
+		else if (output < 0.0f && error > hysteresis)
+		{
+			// A rising switch completes a full cycle
+			output = amplitude;
+			CompleteCycle();
+		}
+
+		return output;
+	}
+
+	State CurrentState() const { return state; }
+
+	bool IsRunning() const { return state == RUNNING; }
+
+	float UltimateGain() const { return ultimateGain; }
+
+	float UltimatePeriod() const { return ultimatePeriod; }
+
+	// Classic Ziegler-Nichols PID rules, in the parallel form used by the PID controllers
+	float Kp() const { return 0.6f * ultimateGain; }
+	float Ki() const { return 1.2f * ultimateGain / ultimatePeriod; }
+	float Kd() const { return 0.075f * ultimateGain * ultimatePeriod; }
+
+private:
+	void CompleteCycle()
+	{
+		// The first switch only marks the start of the first cycle
+		if (cycleStart >= 0.0f && cycles >= SETTLE_CYCLES)
+		{
+			periodSum += time - cycleStart;
+			peakSum += maxError - minError;
+		}
+
+		if (cycleStart >= 0.0f)
+			++cycles;
+
+		cycleStart = time;
+		minError = 0.0f;
+		maxError = 0.0f;
+
+		if (cycles < SETTLE_CYCLES + MEASURE_CYCLES)
+			return;
+
+		float period = periodSum / MEASURE_CYCLES;
+		float oscillation = 0.5f * peakSum / MEASURE_CYCLES;
+
+		// The oscillation has to exceed the hysteresis for the estimate to be meaningful
+		if (oscillation <= hysteresis || period <= 0.0f)
+		{
+			state = FAILED;
+			output = 0.0f;
+
+			return;
+		}
+
+		ultimatePeriod = period;
+		ultimateGain = 4.0f * amplitude / (static_cast<float>(M_PI) * sqrtf(oscillation * oscillation - hysteresis * hysteresis));
+
+		state = FINISHED;
+		output = 0.0f;
+	}
+
+};
+
+}
+
+#endif
@@ -5,13 +5,18 @@
 
 namespace bothezat
 {
-	
+
+/*
+ *	Ring buffer with a power of two capacity. Offsets run freely and are masked to an index on access,
+ *	so the used size is a plain subtraction and a full buffer is distinguishable from an empty one.
+ *	Bulk transfers copy at most two contiguous segments with memcpy.
+ */
 class RingBuffer
 {
 public:
 	class ReadStream;
 	class WriteStream;
-	
+
 	friend class ReadStream;
 	friend class WriteStream;
 
@@ -37,42 +42,46 @@ public:
 
 		uint32_t Available() const
 		{
-			return (buffer.size + (buffer.writeStream.offset - offset)) % buffer.size;
+			return buffer.writeStream.offset - offset;
 		}
 
 		uint32_t Seek(int32_t amount)
 		{
 			assert(amount >= 0 && "RingBuffer stream can only seek forward");
 
-			amount = min(amount, Available());
-			
+			amount = min(static_cast<uint32_t>(amount), Available());
+
 			offset += amount;
-			offset = offset % buffer.size;
 
 			return amount;
 		}
 
 		uint32_t Read(uint8_t* buffer, uint32_t length, bool peek = false)
 		{
-			uint32_t bytesRead = 0;
-			uint32_t offset = this->offset;
+			length = min(length, Available());
 
-			// Keep reading until we caught up with the buffer or enough bytes have been read
-			while (offset != this->buffer.writeStream.offset && bytesRead < length)
-			{
-				// Copy the next byte from the internal buffer to our output buffer
-				buffer[bytesRead] = this->buffer.data[offset];
-				++bytesRead;
-
-				// Wrap read offset around if it reaches the end of the buffer
-				offset = (offset + 1) % this->buffer.size;
-			}
+			this->buffer.CopyOut(offset, buffer, length);
 
 			// If we want to consume the data, update the internal reading pointer
 			if (!peek)
-				this->offset = offset;
+				offset += length;
+
+			return length;
+		}
 
-			return bytesRead;
+		// Points the span to the readable data up to the end of the buffer, returns its length. Consume it with Commit()
+		uint32_t PeekSpan(const uint8_t*& span) const
+		{
+			uint32_t index = offset & buffer.mask;
+			span = buffer.data + index;
+
+			return min(Available(), buffer.size - index);
+		}
+
+		void Commit(uint32_t length)
+		{
+			assert(length <= Available());
+			offset += length;
 		}
 	};
 
@@ -99,35 +108,44 @@ public:
 
 		const uint8_t* DataPointer() const
 		{
-			return buffer.data + offset;
+			return buffer.data + (offset & buffer.mask);
 		}
 
 		uint32_t Write(const uint8_t* buffer, uint32_t length)
 		{
-			uint32_t bytesWritten = 0;
+			// Stop writing once the buffer is full, so that the user knows to read the buffer first
+			length = min(length, this->buffer.size - (offset - this->buffer.origin));
+
+			this->buffer.CopyIn(offset, buffer, length);
+			offset += length;
 
-			while (bytesWritten < length)
-			{
-				this->buffer.data[offset] = buffer[bytesWritten];
-				++bytesWritten;
+			return length;
+		};
 
-				// Wrap write offset around if it reaches the end of the buffer
-				offset = (offset + 1) % this->buffer.size;
+		// Points the span to the free space up to the end of the buffer, returns its length. Publish written data with Commit()
+		uint32_t ReserveSpan(uint8_t*& span)
+		{
+			uint32_t index = offset & buffer.mask;
+			span = buffer.data + index;
 
-				// If the write offset is equal to the origin point AFTER incrimation that means the buffer is full
-				// Stop writing so that the user knows to read the buffer first
-				if (offset == this->buffer.origin)
-					break;
-			}
+			return min(buffer.size - (offset - buffer.origin), buffer.size - index);
+		}
 
-			return bytesWritten;
-		};
+		void Commit(uint32_t length)
+		{
+			assert(length <= buffer.size - (offset - buffer.origin));
+			offset += length;
+		}
 
 	};
 
 private:
+	// Transfers up to this size skip memcpy
+	static const uint32_t SMALL_COPY_SIZE = 8;
+
 	uint8_t* data;
 	uint32_t size;
+	uint32_t mask;
 
 	uint32_t origin;
 
@@ -137,7 +155,7 @@ public:
 
 public:
 
-	RingBuffer() : data(NULL), size(0), readStream(*this), writeStream(*this)
+	RingBuffer() : data(NULL), size(0), mask(0), origin(0), readStream(*this), writeStream(*this)
 	{
 
 	}
@@ -151,20 +169,28 @@ public:
 		}
 	}
 
+	// Allocates at least the requested size, rounded up to a power of two
 	void Allocate(uint32_t size)
 	{
-		this->size = size;
-		data = static_cast<uint8_t*>(malloc(size));
+		this->size = RoundCapacity(size);
+		mask = this->size - 1;
+
+		data = static_cast<uint8_t*>(malloc(this->size));
 
 		Clear();
 	}
 
-	uint32_t UsedBytes()
+	uint32_t Size() const
+	{
+		return size;
+	}
+
+	uint32_t UsedBytes() const
 	{
-		return (size + (writeStream.offset - origin)) % size;
+		return writeStream.offset - origin;
 	}
 
-	uint32_t FreeBytes()
+	uint32_t FreeBytes() const
 	{
 		return size - UsedBytes();
 	}
@@ -177,15 +203,160 @@ public:
 	void Clear()
 	{
 		origin = 0;
-		
+
 		readStream.Reset();
 		writeStream.Reset();
 	}
-	
+
+	static uint32_t RoundCapacity(uint32_t size)
+	{
+		uint32_t capacity = 1;
+
+		while (capacity < size)
+			capacity <<= 1;
+
+		return capacity;
+	}
+
+private:
+	void CopyOut(uint32_t offset, uint8_t* buffer, uint32_t length) const
+	{
+		// Scalar values are copied byte by byte, calling memcpy costs more than it saves for them
+		if (length <= SMALL_COPY_SIZE)
+		{
+			for (uint32_t idx = 0; idx < length; ++idx)
+				buffer[idx] = data[(offset + idx) & mask];
+
+			return;
+		}
+
+		uint32_t index = offset & mask;
+		uint32_t first = min(length, size - index);
+
+		memcpy(buffer, data + index, first);
+		memcpy(buffer + first, data, length - first);
+	}
+
+	void CopyIn(uint32_t offset, const uint8_t* buffer, uint32_t length) const
+	{
+		if (length <= SMALL_COPY_SIZE)
+		{
+			for (uint32_t idx = 0; idx < length; ++idx)
+				data[(offset + idx) & mask] = buffer[idx];
+
+			return;
+		}
+
+		uint32_t index = offset & mask;
+		uint32_t first = min(length, size - index);
+
+		memcpy(data + index, buffer, first);
+		memcpy(data, buffer + first, length - first);
+	}
+
+};
+
+/*
+ *	Lock free ring buffer for one producer and one consumer, for example an interrupt handler and the loop.
+ *	Each side only writes its own offset, and the barriers make sure the data is in place before the other side sees the offset move.
+ */
+template <uint32_t SIZE>
+class SpscRingBuffer
+{
+public:
+	// Masking the offsets requires a power of two size
+	typedef char SizeIsPowerOfTwo[(SIZE & (SIZE - 1)) == 0 && SIZE > 0 ? 1 : -1];
+
+private:
+	static const uint32_t MASK = SIZE - 1;
+
+	uint8_t data[SIZE];
+
+	volatile uint32_t writeOffset;
+	volatile uint32_t readOffset;
+
+public:
+	SpscRingBuffer() : writeOffset(0), readOffset(0)
+	{
+
+	}
+
+	uint32_t Available() const
+	{
+		return writeOffset - readOffset;
+	}
+
+	uint32_t FreeBytes() const
+	{
+		return SIZE - (writeOffset - readOffset);
+	}
+
+	// Producer side, returns the amount of bytes that fit
+	uint32_t Write(const uint8_t* buffer, uint32_t length)
+	{
+		// The offset of the other side is read once, it can move at any time
+		uint32_t offset = writeOffset;
+		uint32_t free = SIZE - (offset - readOffset);
+		length = min(length, free);
+
+		uint32_t index = offset & MASK;
+		uint32_t first = min(length, SIZE - index);
+
+		memcpy(data + index, buffer, first);
+		memcpy(data, buffer + first, length - first);
+
+		__DMB();
+		writeOffset = offset + length;
+
+		return length;
+	}
+
+	bool Write(uint8_t value)
+	{
+		uint32_t offset = writeOffset;
+
+		if (offset - readOffset >= SIZE)
+			return false;
+
+		data[offset & MASK] = value;
+
+		__DMB();
+		writeOffset = offset + 1;
+
+		return true;
+	}
+
+	// Consumer side, returns the amount of bytes read
+	uint32_t Read(uint8_t* buffer, uint32_t length)
+	{
+		uint32_t offset = readOffset;
+		uint32_t available = writeOffset - offset;
+		length = min(length, available);
+
+		__DMB();
+
+		uint32_t index = offset & MASK;
+		uint32_t first = min(length, SIZE - index);
+
+		memcpy(buffer, data + index, first);
+		memcpy(buffer + first, data, length - first);
+
+		__DMB();
+		readOffset = offset + length;
+
+		return length;
+	}
+
+	// Consumer side, discards all data
+	void Clear()
+	{
+		readOffset = writeOffset;
+	}
+
 };
 
 
 }
 
 
-#endif
\ No newline at end of file
+#endif
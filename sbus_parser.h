@@ -0,0 +1,119 @@
+#ifndef _SBUS_PARSER_H_
+#define _SBUS_PARSER_H_
+
+#include <stdint.h>
+
+namespace bothezat
+{
+
+/*
+ *	Incremental parser for Futaba S.BUS frames. Has no hardware dependencies so it can also be compiled on a host.
+ *
+ *	A frame consists of 25 bytes:
+ *		 1 byte		header (0x0F)
+ *		22 bytes	16 channels of 11 bits, LSB first
+ *		 1 byte		flags (digital channels 17 and 18, frame lost, failsafe)
+ *		 1 byte		footer (0x00, or 0x04, 0x14, 0x24, 0x34 for S.BUS2)
+ */
+class SbusParser
+{
+
+public:
+	static const uint8_t FRAME_SIZE = 25;
+	static const uint8_t CHANNELS = 16;
+
+	static const uint8_t HEADER = 0x0F;
+
+	static const uint8_t FLAG_FRAME_LOST = 0x04;
+	static const uint8_t FLAG_FAILSAFE = 0x08;
+
+private:
+	uint8_t buffer[FRAME_SIZE];
+	uint8_t position;
+
+	uint16_t channels[CHANNELS];
+	uint8_t flags;
+
+public:
+	SbusParser() : position(0), flags(0)
+	{
+		for (uint8_t channel = 0; channel < CHANNELS; ++channel)
+			channels[channel] = 0;
+	}
+
+	// Discards a partially received frame, the next byte is expected to be a header
+	void Reset()
+	{
+		position = 0;
+	}
+
+	// Adds a received byte, returns true if it completed a valid frame
+	bool Feed(uint8_t data)
+	{
+		// Wait for the start of a frame
+		if (position == 0 && data != HEADER)
+			return false;
+
+		buffer[position++] = data;
+
+		if (position < FRAME_SIZE)
+			return false;
+
+		position = 0;
+
+		if (!IsFooter(data))
+			return false;
+
+		Decode();
+
+		return true;
+	}
+
+	// Raw channel value, 172 ... 1811 at full stick travel
+	uint16_t Channel(uint8_t channel) const { return channels[channel]; }
+
+	// Channel value converted to a pulse length (us)
+	uint16_t PulseLength(uint8_t channel) const
+	{
+		return 1500 + ((int32_t) channels[channel] - 992) * 5 / 8;
+	}
+
+	bool FrameLost() const { return (flags & FLAG_FRAME_LOST) != 0; }
+	bool Failsafe() const { return (flags & FLAG_FAILSAFE) != 0; }
+
+private:
+	static bool IsFooter(uint8_t data)
+	{
+		return data == 0x00 || (data & 0x0F) == 0x04;
+	}
+
+	void Decode()
+	{
+		const uint8_t* data = buffer + 1;
+
+		uint32_t bits = 0;
+		uint8_t bitAmount = 0;
+
+		// Shift bytes in until there are enough bits for the next channel
+		for (uint8_t channel = 0; channel < CHANNELS; ++channel)
+		{
+			while (bitAmount < 11)
+			{
+				bits |= (uint32_t) *data++ << bitAmount;
+				bitAmount += 8;
+			}
+
+			channels[channel] = bits & 0x07FF;
+
+			bits >>= 11;
+			bitAmount -= 11;
+		}
+
+		flags = buffer[FRAME_SIZE - 2];
+	}
+
+};
+
+}
+
+#endif
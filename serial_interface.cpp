@@ -10,7 +10,11 @@
 
 using namespace bothezat;
 
-SerialInterface::SerialInterface() : payloadBuffer(NULL), serialPort(SerialPort::Instance())
+// Ports the interface can communicate over
+static UartSerialPort uartPort(Serial, "UART");
+static UsbSerialPort usbPort(SerialUSB, "USB", SerialInterface::USB_BANDWIDTH);
+
+SerialInterface::SerialInterface() : payloadBuffer(NULL), connectionAmount(0)
 {
 	// Initialize all resource providers and command handlers to NULL
 	for (uint16_t idx = 0; idx < 256; ++idx)
@@ -18,6 +22,10 @@ SerialInterface::SerialInterface() : payloadBuffer(NULL), serialPort(SerialPort:
 		resourceProviders[idx] = NULL;
 		commandHandlers[idx] = NULL;
 	}
+
+	// The programming port is always available, so that messages from before setup are queued on it
+	connections[connectionAmount++].port = &uartPort;
+	uartPort.Open();
 }
 
 SerialInterface::~SerialInterface()
@@ -31,18 +39,40 @@ SerialInterface::~SerialInterface()
 
 void SerialInterface::Setup()
 {
-	messageBuffer.Allocate(MESSAGE_BUFFER_SIZE);
+	if (config.SR_USB_ENABLED)
+	{
+		connections[connectionAmount++].port = &usbPort;
+		usbPort.Open();
+	}
+
+	for (uint8_t connectionIdx = 0; connectionIdx < connectionAmount; ++connectionIdx)
+	{
+		Connection& connection = connections[connectionIdx];
+
+		connection.messageBuffer.Allocate(MESSAGE_BUFFER_SIZE);
+		connection.port->Begin(config.SR_BAUD_RATE);
+	}
+
 	dataBuffer.Allocate(DATA_BUFFER_SIZE);
 
 	payloadBuffer = static_cast<uint8_t*>(malloc(Message::MAX_PAYLOAD_LENGTH));
-
-	serialPort.Begin(config.SR_BAUD_RATE);
 }
 
 void SerialInterface::Loop(uint32_t dt)
 {
-	ReadMessages();
-	ProcessMessages();
+	// Each connection is handled independently, responses go back over the port the request came from
+	for (uint8_t connectionIdx = 0; connectionIdx < connectionAmount; ++connectionIdx)
+	{
+		Connection& connection = connections[connectionIdx];
+		connection.port->UpdateConnection();
+
+		ReadMessages(connection);
+		ProcessMessages(connection);
+
+		PushSubscriptions(connection, dt);
+
+		connection.port->Update();
+	}
 }
 
 void SerialInterface::RegisterResourceProvider(Page::Resource::Type type, ResourceProvider* provider)
@@ -63,47 +93,49 @@ void SerialInterface::SendLog(const char* msg)
 	message.payloadLength 	= strlen(msg);
 	message.payload 		= reinterpret_cast<const uint8_t*>(msg);
 
-	SendMessage(message);
+	// Logs go out over every port
+	for (uint8_t connectionIdx = 0; connectionIdx < connectionAmount; ++connectionIdx)
+		SendMessage(connections[connectionIdx], message, SerialPort::PRIORITY_LOW);
 }
 
-void SerialInterface::ReadMessages()
+void SerialInterface::ReadMessages(Connection& connection)
 {
 	// Read all the data currently in the serial buffer
-	while (serialPort.Available() > 0)
+	while (connection.port->Available() > 0)
 	{
 		// Read in chunks of a maximum of READ_CHUNK_SIZE
-		uint32_t chunkSize = min(Serial.available(), READ_CHUNK_SIZE);
-		chunkSize = serialPort.Read(readChunk, chunkSize);
+		uint32_t chunkSize = min(connection.port->Available(), READ_CHUNK_SIZE);
+		chunkSize = connection.port->Read(readChunk, chunkSize);
 
 		// If there is not enough room for the data in the buffer we try to process the messages that are currently in the buffer
 		// If no messages could be processed this means that the current message is too big for the message buffer
 		// Clear the buffer, discarding the data for the culprit message
-		if (messageBuffer.FreeBytes() < chunkSize && ProcessMessages() == 0)
-			PurgeMessageBuffer();
+		if (connection.messageBuffer.FreeBytes() < chunkSize && ProcessMessages(connection) == 0)
+			PurgeMessageBuffer(connection);
 
 		// Attempt to transfer the newly read data to the message buffer
-		uint32_t bytesWritten = messageBuffer.writeStream.Write(readChunk, chunkSize);
+		uint32_t bytesWritten = connection.messageBuffer.writeStream.Write(readChunk, chunkSize);
 		assert(bytesWritten == chunkSize);
 
 	}
 }
 
-uint32_t SerialInterface::ProcessMessages()
+uint32_t SerialInterface::ProcessMessages(Connection& connection)
 {
 	uint32_t messagesProcessed = 0;
 
-	while (ReadMessage(lastReceivedMessage))
+	while (ReadMessage(connection, connection.lastReceivedMessage))
 	{
-		ProcessMessage(lastReceivedMessage);
+		ProcessMessage(connection, connection.lastReceivedMessage);
 		++messagesProcessed;
 
-		headersRead = false;
+		connection.headersRead = false;
 	}
 
 	return messagesProcessed;
 }
 
-void SerialInterface::ProcessMessage(const Message& message)
+void SerialInterface::ProcessMessage(Connection& connection, const Message& message)
 {
 	// For now, FC only handles requests
 	if (message.phase != Message::PHASE_REQUEST)
@@ -112,20 +144,24 @@ void SerialInterface::ProcessMessage(const Message& message)
 	switch (message.type)
 	{
 		case Message::TYPE_PAGE:
-			ProcessPageRequest(message);
+			ProcessPageRequest(connection, message);
 			break;
 
 		case Message::TYPE_COMMAND:
-			ProcessCommandRequest(message);
+			ProcessCommandRequest(connection, message);
 			break;
 
 		case Message::TYPE_LOG:
-			ProcessLogRequest(message);
+			ProcessLogRequest(connection, message);
+			break;
+
+		case Message::TYPE_SUBSCRIPTION:
+			ProcessSubscriptionRequest(connection, message);
 			break;
 	}
 }
 
-void SerialInterface::ProcessPageRequest(const Message& requestMessage)
+void SerialInterface::ProcessPageRequest(Connection& connection, const Message& requestMessage)
 {
 	dataBuffer.Clear();
 
@@ -148,38 +184,41 @@ void SerialInterface::ProcessPageRequest(const Message& requestMessage)
 	// Iterate through each resource in the request 
 	for (uint32_t resourceIdx = 0; resourceIdx < request.numResources; ++resourceIdx)
 	{
-		Page::Resource::Type type = request.resources[resourceIdx];
-		Page::Resource& resource = response.resources[resourceIdx];
+		SerializeResource(request.resources[resourceIdx], response.resources[resourceIdx]);
+	}
 
-		// Search for a resource provider registered for this type
-		ResourceProvider* resourceProvider = resourceProviders[type];
+	// Send a response message with our response struct as payload
+	SendResponseMessage(connection, requestMessage, response);
+}
 
-		if (resourceProvider != NULL)
-		{
-			// Set the data pointer of the resource to the current position of the write stream
-			// TODO: Check if the resource fits in the buffer
-			resource.data = dataBuffer.writeStream.DataPointer();
-			resource.length = resourceProvider->SerializeResource(type, dataBuffer.writeStream);
-
-			// If the provider couldn't supply the resource, we handle it as an invalid type
-			if (resource.length == 0)
-				resource.type = Page::Resource::INVALID_RESOURCE;
-			else
-				resource.type = type;
-		}
-		else
-		{
-			resource.length = 0;
-			resource.type = Page::Resource::INVALID_RESOURCE;
-		}
+bool SerialInterface::SerializeResource(Page::Resource::Type type, Page::Resource& resource)
+{
+	// Search for a resource provider registered for this type
+	ResourceProvider* resourceProvider = resourceProviders[type];
 
+	if (resourceProvider == NULL)
+	{
+		resource.length = 0;
+		resource.type = Page::Resource::INVALID_RESOURCE;
+
+		return false;
 	}
 
-	// Send a response message with our response struct as payload
-	SendResponseMessage(requestMessage, response);
+	// Set the data pointer of the resource to the current position of the write stream
+	// TODO: Check if the resource fits in the buffer
+	resource.data = dataBuffer.writeStream.DataPointer();
+	resource.length = resourceProvider->SerializeResource(type, dataBuffer.writeStream);
+
+	// If the provider couldn't supply the resource, we handle it as an invalid type
+	if (resource.length == 0)
+		resource.type = Page::Resource::INVALID_RESOURCE;
+	else
+		resource.type = type;
+
+	return true;
 }
 
-void SerialInterface::ProcessCommandRequest(const Message& requestMessage)
+void SerialInterface::ProcessCommandRequest(Connection& connection, const Message& requestMessage)
 {
 	dataBuffer.Clear();
 
@@ -213,42 +252,149 @@ void SerialInterface::ProcessCommandRequest(const Message& requestMessage)
 	}
 
 	// Send a response message with our response struct as payload
-	SendResponseMessage(requestMessage, response);
+	SendResponseMessage(connection, requestMessage, response);
 }
 
-void SerialInterface::ProcessLogRequest(const Message& requestMessage)
+void SerialInterface::ProcessLogRequest(Connection& connection, const Message& requestMessage)
 {
 
 }
 
-bool SerialInterface::ReadMessage(Message& message)
+void SerialInterface::ProcessSubscriptionRequest(Connection& connection, const Message& requestMessage)
 {
-	if (!headersRead && !ReadMessageHeaders(message))
+	Page::SubscriptionRequestMessage request;
+	Page::SubscriptionResponseMessage response;
+
+	// Deserialize the request struct from the payload
+	MemoryStream stream(requestMessage.payload, requestMessage.payloadLength);
+	bool result = request.Deserialize(stream);
+
+	if (!result)
+	{
+		Debug::Print("Failed to deserialize subscription request!\n");
+		return;
+	}
+
+	// The new set of subscriptions replaces the old one
+	connection.subscriptionAmount = 0;
+	connection.nextSubscription = 0;
+
+	for (uint32_t subscriptionIdx = 0; subscriptionIdx < request.numSubscriptions; ++subscriptionIdx)
+	{
+		const Page::Subscription& requested = request.subscriptions[subscriptionIdx];
+
+		if (requested.rate == 0 || resourceProviders[requested.type] == NULL)
+			continue;
+
+		Subscription& subscription = connection.subscriptions[connection.subscriptionAmount++];
+		subscription.type = requested.type;
+		subscription.interval = 1000000 / requested.rate;
+		subscription.elapsed = subscription.interval;
+		subscription.lastLength = 0;
+	}
+
+	connection.subscriptionRequest = requestMessage;
+	connection.subscriptionRequest.payload = NULL;
+
+	response.numSubscriptions = connection.subscriptionAmount;
+
+	SendResponseMessage(connection, requestMessage, response);
+}
+
+void SerialInterface::PushSubscriptions(Connection& connection, uint32_t dt)
+{
+	if (connection.subscriptionAmount == 0)
+		return;
+
+	// Refill the budget with the configured share of the bandwidth of the port
+	float bytesPerSecond = connection.port->Bandwidth() * config.SR_TELEMETRY_SHARE;
+
+	connection.telemetryBudget = min(connection.telemetryBudget + bytesPerSecond * dt * 1e-6f, bytesPerSecond * TELEMETRY_BURST_TIME);
+
+	for (uint8_t subscriptionIdx = 0; subscriptionIdx < connection.subscriptionAmount; ++subscriptionIdx)
+		connection.subscriptions[subscriptionIdx].elapsed += dt;
+
+	// A message that overdraws the budget is paid back before the next one
+	if (connection.telemetryBudget <= 0.0f)
+		return;
+
+	// Don't build batches the transmit queue has no room for
+	float budget = min(connection.telemetryBudget, (float) connection.port->WritableBytes(SerialPort::PRIORITY_LOW));
+
+	dataBuffer.Clear();
+
+	// All subscriptions that are due go out in a single batch, as far as the budget allows
+	Page::ResponseMessage response;
+	response.numResources = 0;
+
+	uint32_t messageSize = Message::HEADER_SIZE + sizeof(response.numResources);
+
+	for (uint8_t count = 0; count < connection.subscriptionAmount; ++count)
+	{
+		uint8_t subscriptionIdx = (connection.nextSubscription + count) % connection.subscriptionAmount;
+		Subscription& subscription = connection.subscriptions[subscriptionIdx];
+
+		if (subscription.elapsed < subscription.interval)
+			continue;
+
+		// Leave the remaining subscriptions for the next batch, which starts with them
+		uint32_t predictedSize = sizeof(uint8_t) + sizeof(uint32_t) + subscription.lastLength;
+
+		if (response.numResources > 0 && messageSize + predictedSize > budget)
+		{
+			connection.nextSubscription = subscriptionIdx;
+			break;
+		}
+
+		Page::Resource& resource = response.resources[response.numResources++];
+		SerializeResource(subscription.type, resource);
+
+		subscription.lastLength = resource.length;
+		messageSize += resource.SerializedSize();
+
+		// Keep the phase of the interval, unless the push is so late that catching up would cause a burst
+		if (subscription.elapsed >= subscription.interval * 2)
+			subscription.elapsed = 0;
+		else
+			subscription.elapsed -= subscription.interval;
+	}
+
+	if (response.numResources == 0)
+		return;
+
+	connection.telemetryBudget -= messageSize;
+
+	SendResponseMessage(connection, connection.subscriptionRequest, response, SerialPort::PRIORITY_LOW);
+}
+
+bool SerialInterface::ReadMessage(Connection& connection, Message& message)
+{
+	if (!connection.headersRead && !ReadMessageHeaders(connection, message))
 		return false;
 
 	// Check if there is enough data in the buffer for the complete message
-	if (messageBuffer.readStream.Available() < message.payloadLength)
+	if (connection.messageBuffer.readStream.Available() < message.payloadLength)
 		return false;
 
 	// Read the message into the shared payload buffer
-	messageBuffer.readStream.Read(payloadBuffer, message.payloadLength);
+	connection.messageBuffer.readStream.Read(payloadBuffer, message.payloadLength);
 	message.payload = payloadBuffer;
 
 	return true; 
 }
 
-bool SerialInterface::ReadMessageHeaders(Message& message)
+bool SerialInterface::ReadMessageHeaders(Connection& connection, Message& message)
 {
 	// We need to sync the read stream on a message boundary
-	if (!SyncMessageStream())
+	if (!SyncMessageStream(connection))
 		return false;
 
 	// Attempt to read the message headers
-	if (!message.Deserialize(messageBuffer.readStream))
+	if (!message.Deserialize(connection.messageBuffer.readStream))
 		return false;
 
 	// Discard header data from the buffer
-	messageBuffer.Trim();
+	connection.messageBuffer.Trim();
 
 	// Verify CRC the message checksum
 	Util::crc crc = CalculateMessageCRC(message);
@@ -261,22 +407,22 @@ bool SerialInterface::ReadMessageHeaders(Message& message)
 		return false;
 	}
 
-	headersRead = true;
+	connection.headersRead = true;
 
 	return true;
 }
 
-bool SerialInterface::SyncMessageStream()
+bool SerialInterface::SyncMessageStream(Connection& connection)
 {
 	uint32_t bytesSkipped = 0;
 
 	// Make sure the read buffer is synced with a message boundary
-	while (messageBuffer.readStream.Available() >= sizeof(uint32_t))
+	while (connection.messageBuffer.readStream.Available() >= sizeof(uint32_t))
 	{
 		// As long as we aren't at a message boundary we can discard the data before the current stream point
-		messageBuffer.Trim();
+		connection.messageBuffer.Trim();
 
-		uint32_t magic = messageBuffer.readStream.ReadUInt32(true);
+		uint32_t magic = connection.messageBuffer.readStream.ReadUInt32(true);
 
 		// If the read number conforms to the magic number, we probably are at a message start
 		if (magic == Message::MESSAGE_MAGIC)
@@ -288,11 +434,11 @@ bool SerialInterface::SyncMessageStream()
 		}
 
 		// Check if there is more data available
-		if (messageBuffer.readStream.Available() == 0)
+		if (connection.messageBuffer.readStream.Available() == 0)
 			break;
 
 		// Advance one byte and try again
-		messageBuffer.readStream.ReadByte(); 
+		connection.messageBuffer.readStream.ReadByte(); 
 		++bytesSkipped;
 	} 
 
@@ -300,19 +446,22 @@ bool SerialInterface::SyncMessageStream()
 	return false;
 }
 
-void SerialInterface::SendMessage(Message& message)
+void SerialInterface::SendMessage(Connection& connection, Message& message, SerialPort::Priority priority)
 {
+	if (!connection.port->Reserve(message.SerializedSize() + message.payloadLength, priority))
+		return;
+
 	message.id 		= GetNextMessageID();
 	message.crc 	= CalculateMessageCRC(message);
 	
 	// Serialize the message headers to the serial port
-	message.Serialize(serialPort);
+	message.Serialize(*connection.port);
 
 	// Write the message payload to the serial port
-	serialPort.Write(message.payload, message.payloadLength);
+	connection.port->Write(message.payload, message.payloadLength);
 }
 
-void SerialInterface::SendResponseMessage(const Message& requestMessage, Serializable& payload)
+void SerialInterface::SendResponseMessage(Connection& connection, const Message& requestMessage, Serializable& payload, SerialPort::Priority priority)
 {
 	// Create a message struct for the response header
 	Message responseMessage;
@@ -322,17 +471,20 @@ void SerialInterface::SendResponseMessage(const Message& requestMessage, Seriali
 	responseMessage.payloadLength 	= payload.SerializedSize();
 	responseMessage.crc 			= CalculateMessageCRC(responseMessage);
 
+	if (!connection.port->Reserve(responseMessage.SerializedSize() + responseMessage.payloadLength, priority))
+		return;
+
 	// Serialize the message headers to the serial port
-	responseMessage.Serialize(serialPort);
+	responseMessage.Serialize(*connection.port);
 
 	// Serialize the message payload to the serial port
-	payload.Serialize(serialPort);
+	payload.Serialize(*connection.port);
 }
 
-void SerialInterface::PurgeMessageBuffer()
+void SerialInterface::PurgeMessageBuffer(Connection& connection)
 {
-	messageBuffer.Clear();
-	headersRead = false;
+	connection.messageBuffer.Clear();
+	connection.headersRead = false;
 
 	Debug::Print("Purging message buffer!\n");
 }
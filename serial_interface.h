@@ -16,6 +16,10 @@ class SerialInterface : public Module<SerialInterface>
 {
 friend class Module<SerialInterface>;
 
+public:
+	// Bytes per second over the native USB port, which moves data at USB full speed regardless of the baud rate
+	static const uint32_t USB_BANDWIDTH = 1000000;
+
 private:
 	static const uint32_t READ_CHUNK_SIZE = 16;
 
@@ -45,6 +49,7 @@ private:
 			TYPE_PAGE  			= 0x01,
 			TYPE_COMMAND 		= 0x02,
 			TYPE_LOG 			= 0x03,
+			TYPE_SUBSCRIPTION	= 0x04,
 
 			TYPE_LAST_VALUE 	= 0xFF
 		};
@@ -110,26 +115,69 @@ private:
 		}
 	};
 
+	// Resource pushed to the host at a fixed interval
+	struct Subscription
+	{
+		Page::Resource::Type type;
+
+		// Time (us) between pushes, and since the last push
+		uint32_t interval;
+		uint32_t elapsed;
+
+		// Size of the resource at the last push, used to predict if it fits the bandwidth budget
+		uint32_t lastLength;
+	};
+
+	// Host connected over one of the serial ports, every connection runs the full protocol on its own
+	struct Connection
+	{
+		SerialPort* port;
+
+		RingBuffer messageBuffer;
+
+		// The message that was last received, or is currently being read
+		Message lastReceivedMessage;
+
+		// Whether the headers have been read for the message that we currently are receiving
+		bool headersRead;
+
+		Subscription subscriptions[Page::MAX_SUBSCRIPTIONS];
+		uint8_t subscriptionAmount;
+
+		// Headers of the subscription request, pushes are sent as responses to it
+		Message subscriptionRequest;
+
+		// Bytes the subscriptions may still send, refilled with a share of the bandwidth of the port
+		float telemetryBudget;
+
+		// Subscription the next batch starts with, so all subscriptions get their turn when the budget is tight
+		uint8_t nextSubscription;
+
+		Connection() : port(NULL), headersRead(false), subscriptionAmount(0), telemetryBudget(0.0f), nextSubscription(0)
+		{
+
+		}
+	};
+
+	// Maximum time (s) of unused bandwidth the budget can save up, limits the size of bursts
+	static const float TELEMETRY_BURST_TIME = 0.05f;
+
+	// The programming port and the native USB port
+	static const uint8_t MAX_CONNECTIONS = 2;
+
 	// Intermediate buffer for reading serial data. Data is read to this buffer and then transferred to the larger ring buffer
 	uint8_t readChunk[READ_CHUNK_SIZE];
 
 	ResourceProvider* resourceProviders[256];
 	CommandHandler* commandHandlers[256];
 
-	RingBuffer messageBuffer;
 	RingBuffer dataBuffer;
 
-	// The message that was last received, or is currently being read
-	Message lastReceivedMessage;
-
 	// Shared buffer for message payload, is allocated with MAX_PAYLOAD_LENGTH
 	uint8_t* payloadBuffer;
 
-	// The serial port wrapper to use for all communication
-	SerialPort serialPort;
-
-	// Whether the headers have been read for the message that we currently are receiving
-	bool headersRead;
+	Connection connections[MAX_CONNECTIONS];
+	uint8_t connectionAmount;
 
 protected:
 	SerialInterface();
@@ -147,25 +195,32 @@ public:
 
 private:
 
-	void ReadMessages();
-	uint32_t ProcessMessages();
-	void ProcessMessage(const Message& message);
+	void ReadMessages(Connection& connection);
+	uint32_t ProcessMessages(Connection& connection);
+	void ProcessMessage(Connection& connection, const Message& message);
+
+	void ProcessPageRequest(Connection& connection, const Message& requestMessage);
+	void ProcessCommandRequest(Connection& connection, const Message& requestMessage);
+	void ProcessLogRequest(Connection& connection, const Message& requestMessage);
+	void ProcessSubscriptionRequest(Connection& connection, const Message& requestMessage);
+
+	// Serializes a resource into the data buffer, returns false if there is no provider for it
+	bool SerializeResource(Page::Resource::Type type, Page::Resource& resource);
 
-	void ProcessPageRequest(const Message& requestMessage);
-	void ProcessCommandRequest(const Message& requestMessage);
-	void ProcessLogRequest(const Message& requestMessage);
+	void PushSubscriptions(Connection& connection, uint32_t dt);
 
-	bool ReadMessage(Message& message);
-	bool ReadMessageHeaders(Message& message);
+	bool ReadMessage(Connection& connection, Message& message);
+	bool ReadMessageHeaders(Connection& connection, Message& message);
 
-	void SendMessage(Message& message);
-	void SendResponseMessage(const Message& requestMessage, Serializable& payload);
+	// Messages are queued without blocking, or dropped if the queue has no room for their priority
+	void SendMessage(Connection& connection, Message& message, SerialPort::Priority priority);
+	void SendResponseMessage(Connection& connection, const Message& requestMessage, Serializable& payload, SerialPort::Priority priority = SerialPort::PRIORITY_HIGH);
 	
 	void Send(uint8_t data);
 	void Send(const uint8_t* buffer, uint32_t size);
 
-	bool SyncMessageStream();
-	void PurgeMessageBuffer();
+	bool SyncMessageStream(Connection& connection);
+	void PurgeMessageBuffer(Connection& connection);
 
 	Util::crc CalculateMessageCRC(const Message& message) const;
 	uint32_t GetNextMessageID() { return random(0, 1 << 31); };
@@ -0,0 +1,145 @@
+#include "Arduino.h"
+#include "bothezat.h"
+
+#include "serial_receiver.h"
+
+using namespace bothezat;
+
+SerialReceiver::SerialReceiver() : Receiver(), protocol(RECEIVER_SBUS), readPosition(0), timeSinceByte(0), timeSinceFrame(0)
+{
+
+}
+
+void SerialReceiver::Setup()
+{
+	protocol = static_cast<Type>(config.RX_RECEIVER_TYPE);
+
+	switch (protocol)
+	{
+		case RECEIVER_SPEKTRUM:
+			// 115200 baud, 8N1
+			ConfigureUsart(115200, US_MR_CHRL_8_BIT | US_MR_PAR_NO | US_MR_NBSTOP_1_BIT);
+			Debug::Print("Spektrum satellite receiver on USART0\n");
+			break;
+
+		case RECEIVER_SBUS:
+		default:
+			// 100000 baud, 8E2. The signal is inverted, which the USART can't undo, so it needs an external inverter
+			protocol = RECEIVER_SBUS;
+			ConfigureUsart(100000, US_MR_CHRL_8_BIT | US_MR_PAR_EVEN | US_MR_NBSTOP_2_BIT);
+			Debug::Print("S.BUS receiver on USART0\n");
+			break;
+	}
+}
+
+void SerialReceiver::ConfigureUsart(uint32_t baudRate, uint32_t mode)
+{
+	// Configure the RX pin, TX is not used
+	const PinDescription& desc = g_APinDescription[Config::Pins::RX_SERIAL];
+	PIO_Configure(desc.pPort, desc.ulPinType, desc.ulPin, desc.ulPinConfiguration);
+
+	pmc_enable_periph_clk(ID_USART0);
+
+	// Reset and disable the receiver and transmitter while configuring
+	USART0->US_PTCR = US_PTCR_RXTDIS | US_PTCR_TXTDIS;
+	USART0->US_CR = US_CR_RSTRX | US_CR_RSTTX | US_CR_RXDIS | US_CR_TXDIS;
+
+	USART0->US_MR = US_MR_USART_MODE_NORMAL | US_MR_USCLKS_MCK | US_MR_CHMODE_NORMAL | mode;
+	USART0->US_BRGR = (VARIANT_MCK / baudRate) / 16;
+
+	// No interrupts, the PDC handles all received bytes
+	USART0->US_IDR = 0xFFFFFFFF;
+
+	// Let the PDC receive into the buffer, and wrap around to the start of the buffer when it is full
+	USART0->US_RPR = (uint32_t) buffer;
+	USART0->US_RCR = BUFFER_SIZE;
+	USART0->US_RNPR = (uint32_t) buffer;
+	USART0->US_RNCR = BUFFER_SIZE;
+
+	USART0->US_PTCR = US_PTCR_RXTEN;
+	USART0->US_CR = US_CR_RXEN;
+}
+
+void SerialReceiver::Loop(uint32_t dt)
+{
+	Receiver::Loop(dt);
+
+	timeSinceByte += dt;
+	timeSinceFrame += dt;
+
+	// Once the PDC moved on to the next buffer, queue the buffer again so reception never stops
+	if (USART0->US_RNCR == 0)
+	{
+		USART0->US_RNPR = (uint32_t) buffer;
+		USART0->US_RNCR = BUFFER_SIZE;
+	}
+
+	// Reading the status clears the error flags of corrupted bytes, the parsers reject the frames they end up in
+	if (USART0->US_CSR & (US_CSR_OVRE | US_CSR_FRAME | US_CSR_PARE))
+		USART0->US_CR = US_CR_RSTSTA;
+
+	uint16_t writePosition = WritePosition();
+
+	if (writePosition == readPosition)
+	{
+		// A gap between bytes marks the start of a new frame
+		if (timeSinceByte > FRAME_GAP)
+		{
+			sbusParser.Reset();
+			spektrumParser.Reset();
+		}
+	}
+	else
+		timeSinceByte = 0;
+
+	bool frameReceived = false;
+
+	while (readPosition != writePosition)
+	{
+		if (Parse(buffer[readPosition]))
+			frameReceived = true;
+
+		if (++readPosition >= BUFFER_SIZE)
+			readPosition = 0;
+	}
+
+	if (frameReceived)
+	{
+		timeSinceFrame = 0;
+		ReadChannels();
+	}
+
+	SetConnected(timeSinceFrame <= FRAME_TIMEOUT && !(protocol == RECEIVER_SBUS && sbusParser.Failsafe()));
+}
+
+uint16_t SerialReceiver::WritePosition()
+{
+	uint16_t position = USART0->US_RPR - (uint32_t) buffer;
+
+	// The pointer points just past the buffer while switching to the next one
+	return position >= BUFFER_SIZE ? 0 : position;
+}
+
+bool SerialReceiver::Parse(uint8_t data)
+{
+	if (protocol == RECEIVER_SPEKTRUM)
+		return spektrumParser.Feed(data);
+	else
+		return sbusParser.Feed(data);
+}
+
+void SerialReceiver::ReadChannels()
+{
+	uint16_t channels[Config::Constants::RX_MAX_CHANNELS];		// Pulse length for each channel
+
+	for (uint8_t channel = 0; channel < Config::Constants::RX_MAX_CHANNELS; ++channel)
+	{
+		if (protocol == RECEIVER_SPEKTRUM)
+			channels[channel] = spektrumParser.PulseLength(channel);
+		else
+			channels[channel] = sbusParser.PulseLength(channel);
+	}
+
+	// Save new pulse lengths
+	UpdateChannels(channels);
+}
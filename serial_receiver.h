@@ -0,0 +1,67 @@
+#ifndef _SERIAL_RECEIVER_H_
+#define _SERIAL_RECEIVER_H_
+
+#include "Arduino.h"
+#include "receiver.h"
+
+#include "sbus_parser.h"
+#include "spektrum_parser.h"
+
+namespace bothezat
+{
+
+/*
+ *	Class which reads serial radio receivers (S.BUS and Spektrum satellites) on the RX pin of USART0.
+ *
+ *	The PDC continuously writes received bytes into a circular buffer without any interrupts,
+ *	the loop feeds the bytes received since the last loop to the frame parser of the protocol.
+ */
+class SerialReceiver : public Receiver, public Module<SerialReceiver>
+{
+friend class Module<SerialReceiver>;
+
+using Module<SerialReceiver>::config;
+
+public:
+	static const uint16_t BUFFER_SIZE = 128;
+
+	// Time (us) without new bytes after which a partially received frame is discarded
+	static const uint32_t FRAME_GAP = 2000;
+
+	// Time (us) without a complete frame after which the receiver is considered disconnected
+	static const uint32_t FRAME_TIMEOUT = 100000;
+
+private:
+	Type protocol;
+
+	uint8_t buffer[BUFFER_SIZE];
+
+	// Position in the buffer up to which bytes have been parsed
+	uint16_t readPosition;
+
+	uint32_t timeSinceByte, timeSinceFrame;
+
+	SbusParser sbusParser;
+	SpektrumParser spektrumParser;
+
+protected:
+	SerialReceiver();
+
+public:
+	virtual void Setup();
+
+	virtual void Loop(uint32_t dt);
+
+private:
+	void ConfigureUsart(uint32_t baudRate, uint32_t mode);
+
+	uint16_t WritePosition();
+
+	bool Parse(uint8_t data);
+	void ReadChannels();
+
+};
+
+}
+
+#endif
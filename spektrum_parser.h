@@ -0,0 +1,112 @@
+#ifndef _SPEKTRUM_PARSER_H_
+#define _SPEKTRUM_PARSER_H_
+
+#include <stdint.h>
+
+namespace bothezat
+{
+
+/*
+ *	Incremental parser for Spektrum DSM2 / DSMX satellite frames. Has no hardware dependencies so it can also be compiled on a host.
+ *
+ *	A frame consists of 16 bytes:
+ *		1 byte		fades
+ *		1 byte		system, which determines the resolution
+ *		7 words		channel id and value, MSB first. Unused words are 0xFFFF
+ *
+ *	Frames have no header, the start of a frame is only marked by the gap before it. The receiver should call Reset()
+ *	when it detects such a gap. Each frame may hold a different subset of channels, all received channels are kept.
+ */
+class SpektrumParser
+{
+
+public:
+	static const uint8_t FRAME_SIZE = 16;
+	static const uint8_t CHANNELS = 12;
+
+	// System byte for DSM2 with 1024 steps, all other systems use 2048 steps
+	static const uint8_t SYSTEM_DSM2_1024 = 0x01;
+
+private:
+	uint8_t buffer[FRAME_SIZE];
+	uint8_t position;
+
+	uint16_t channels[CHANNELS];
+
+	bool highResolution;
+
+public:
+	SpektrumParser() : position(0), highResolution(true)
+	{
+		for (uint8_t channel = 0; channel < CHANNELS; ++channel)
+			channels[channel] = 0;
+	}
+
+	// Marks the start of a new frame
+	void Reset()
+	{
+		position = 0;
+	}
+
+	// Adds a received byte, returns true if it completed a frame
+	bool Feed(uint8_t data)
+	{
+		buffer[position++] = data;
+
+		if (position < FRAME_SIZE)
+			return false;
+
+		position = 0;
+
+		Decode();
+
+		return true;
+	}
+
+	// Raw channel value, 0 ... 1023 or 0 ... 2047 depending on the resolution
+	uint16_t Channel(uint8_t channel) const { return channels[channel]; }
+
+	// Channel value converted to a pulse length (us)
+	uint16_t PulseLength(uint8_t channel) const
+	{
+		return highResolution ? 988 + (channels[channel] >> 1) : 988 + channels[channel];
+	}
+
+	bool IsHighResolution() const { return highResolution; }
+
+private:
+	void Decode()
+	{
+		highResolution = buffer[1] != SYSTEM_DSM2_1024;
+
+		for (uint8_t word = 0; word < 7; ++word)
+		{
+			uint16_t value = ((uint16_t) buffer[2 + word * 2] << 8) | buffer[3 + word * 2];
+
+			// Skip unused words
+			if (value == 0xFFFF)
+				continue;
+
+			uint8_t channel;
+
+			if (highResolution)
+			{
+				channel = (value >> 11) & 0x0F;
+				value &= 0x07FF;
+			}
+			else
+			{
+				channel = (value >> 10) & 0x0F;
+				value &= 0x03FF;
+			}
+
+			if (channel < CHANNELS)
+				channels[channel] = value;
+		}
+	}
+
+};
+
+}
+
+#endif
@@ -4,7 +4,7 @@
 
 using namespace bothezat;
 
-StickCommands::StickCommands() : registeredCommands(0), receiver(NULL), motorController(NULL)
+StickCommands::StickCommands() : receiver(NULL), motorController(NULL), normalizedRevision(0), configRevision(0), elapsed(0)
 {
 	
 }
@@ -18,54 +18,40 @@ void StickCommands::Setup()
 
 void StickCommands::Loop(uint32_t dt)
 {
-	for (uint8_t commandIdx = 0; commandIdx < registeredCommands; ++commandIdx)
+	// Rules might have moved around, start over without executing anything
+	if (configRevision != config.Revision())
 	{
-		Command& command = commands[commandIdx];
-		
-		bool sticksMatching = true;
-
-		// Check the position of the first 4 channels
-		for (uint8_t channel = 0; channel < 4; ++channel)
-		{
-			int desiredState = command.stickStates[channel];
-
-			if (desiredState == 0)
-				continue;
-
-			float value = receiver->NormalizedChannel((Receiver::Channel) channel);	
-
-			// Check if the stick is in the correct position
-			if (abs(value) < MIN_STICK_POSITION || (value < 0.0f && desiredState == 1) || (value > 0.0f && desiredState == -1))
-			{
-				sticksMatching = false;
-				break;
-			}
-		}
-
-		if (sticksMatching)
-		{
-			if (!command.active)
-			{
-				ExecuteCommand(command);
-				command.active = true;
-			}
-		}
-		else
-			command.active = false;
+		for (uint8_t commandIdx = 0; commandIdx < Config::Constants::SC_MAX_COMMANDS; ++commandIdx)
+			states[commandIdx] = SwitchEvaluator::State();
+
+		configRevision = config.Revision();
 	}
-}
 
-void StickCommands::AddCommand(Command& command)
-{
-	if (registeredCommands >= Config::Constants::SC_MAX_COMMANDS)
+	elapsed += dt;
+
+	// Nothing can change until the receiver has new values
+	if (receiver->NormalizedRevision() == normalizedRevision)
 		return;
 
-	commands[registeredCommands++] = command;
+	normalizedRevision = receiver->NormalizedRevision();
+
+	const float* channels = receiver->NormalizedChannels();
+
+	for (uint8_t commandIdx = 0; commandIdx < Config::Constants::SC_MAX_COMMANDS; ++commandIdx)
+	{
+		const Config::SwitchRule& rule = config.SC_COMMANDS[commandIdx];
+
+		// Commands are executed once when the sticks have been held in position
+		if (SwitchEvaluator::Evaluate(rule, states[commandIdx], channels, elapsed) == SwitchEvaluator::EDGE_ACTIVATED)
+			ExecuteCommand(rule.action);
+	}
+
+	elapsed = 0;
 }
 
-void StickCommands::ExecuteCommand(Command& command)
+void StickCommands::ExecuteCommand(uint8_t type)
 {
-	switch (command.type)
+	switch (type)
 	{
 		case Command::ARM_MOTORS:
 			if (!motorController->IsArmed())
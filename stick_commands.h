@@ -6,23 +6,25 @@
 #include "module.h"
 
 #include "receiver.h"
+#include "switch_evaluator.h"
 
 namespace bothezat
 {
 
 class MotorController;
 
+/*
+ *	Executes commands when the sticks are held in a position, as configured by the SC_COMMANDS rules
+ */
 class StickCommands : public Module<StickCommands>
 {
 friend class Module<StickCommands>;
 
-private:
-	static const float MIN_STICK_POSITION = 0.85f;
-
 public:
 
 	struct Command
 	{
+		// Action of a stick command rule in the config
 		enum Type
 		{
 			UNKNOWN,
@@ -31,33 +33,19 @@ public:
 			DISARM_MOTORS,
 			TOGGLE_ARM_STATE
 		};
-
-		Type type;
-
-		int8_t stickStates[4];
-
-		bool active;
-
-		Command() : type(UNKNOWN), active(false)
-		{
-			for (uint8_t channel = 0; channel < 4; ++channel)
-				stickStates[channel] = 0;
-		}
-
-		void SetStickState(Receiver::Channel channel, int8_t state)
-		{
-			stickStates[channel] = state;
-		}
 	};
 
-	Command commands[Config::Constants::SC_MAX_COMMANDS];
-
-	uint8_t registeredCommands;
+private:
+	SwitchEvaluator::State states[Config::Constants::SC_MAX_COMMANDS];
 
 	Receiver* receiver;
 
 	MotorController* motorController;
 
+	// Normalized receiver values and config the rules were last evaluated for, and the time since
+	uint32_t normalizedRevision, configRevision;
+	uint32_t elapsed;
+
 protected:
 	StickCommands();
 
@@ -66,11 +54,9 @@ public:
 
 	virtual void Loop(uint32_t dt);
 
-	void AddCommand(Command& function);
-
 private:
 
-	void ExecuteCommand(Command& command);
+	void ExecuteCommand(uint8_t type);
 
 };
 
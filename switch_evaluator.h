@@ -0,0 +1,98 @@
+#ifndef _SWITCH_EVALUATOR_H_
+#define _SWITCH_EVALUATOR_H_
+
+#include "Arduino.h"
+#include "config.h"
+
+namespace bothezat
+{
+
+/*
+ *	Evaluates the switch rules from the config against the normalized receiver channels. Shared by the aux functions
+ *	and stick commands, which only evaluate their rules when the receiver channels changed and act on the returned edges.
+ */
+class SwitchEvaluator
+{
+public:
+	enum Edge
+	{
+		EDGE_NONE = 0,
+		EDGE_ACTIVATED,
+		EDGE_DEACTIVATED
+	};
+
+	// Runtime state of a rule
+	struct State
+	{
+		bool active;
+
+		// Whether the channels were in range at the previous evaluation, and for how long (us)
+		bool matching;
+		uint32_t heldTime;
+
+		State() : active(false), matching(false), heldTime(0)
+		{
+
+		}
+	};
+
+	// Updates the state of a rule, dt is the time since the previous evaluation
+	static Edge Evaluate(const Config::SwitchRule& rule, State& state, const float* channels, uint32_t dt)
+	{
+		if (rule.action == 0)
+			return EDGE_NONE;
+
+		if (!IsMatching(rule, channels, state.active ? rule.hysteresis : 0.0f))
+		{
+			state.matching = false;
+
+			if (!state.active)
+				return EDGE_NONE;
+
+			state.active = false;
+			return EDGE_DEACTIVATED;
+		}
+
+		if (state.active)
+			return EDGE_NONE;
+
+		// The hold time starts at the first evaluation that is in range
+		if (state.matching)
+			state.heldTime += dt;
+		else
+		{
+			state.matching = true;
+			state.heldTime = 0;
+		}
+
+		if (state.heldTime < rule.holdTime * 1000UL)
+			return EDGE_NONE;
+
+		state.active = true;
+		return EDGE_ACTIVATED;
+	}
+
+private:
+	static bool IsMatching(const Config::SwitchRule& rule, const float* channels, float margin)
+	{
+		for (uint8_t condition = 0; condition < Config::SwitchRule::CONDITIONS; ++condition)
+		{
+			uint8_t channel = rule.channels[condition];
+
+			if (channel >= Config::Constants::RX_MAX_CHANNELS)
+				continue;
+
+			float value = channels[channel];
+
+			if (value < rule.min[condition] - margin || value > rule.max[condition] + margin)
+				return false;
+		}
+
+		return true;
+	}
+
+};
+
+}
+
+#endif
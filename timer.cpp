@@ -27,7 +27,7 @@ Timer Timer::timerPool[TIMER_AMOUNT] =
 };
 
 Timer::Timer(Tc* timer, uint8_t channel, IRQn_Type irq) : 
-	timer(timer), channel(channel), irq(irq), free(true)
+	timer(timer), channel(channel), irq(irq), free(true), handler(NULL)
 {
 
 }
@@ -46,6 +46,7 @@ Timer& Timer::operator=(const Timer& other)
 	channel 	= other.channel;
 	irq 		= other.irq;
 	free 		= other.free;
+	handler 	= other.handler;
 
 	return *this;
 }
@@ -83,7 +84,17 @@ uint32_t Timer::ReadValue() const
 	return TC_ReadCV(timer, channel);
 }
 
-uint32_t Timer::SetPrecision(uint32_t desiredPrecision)
+void Timer::EnableInterrupts(uint32_t mask)
+{
+	timer->TC_CHANNEL[channel].TC_IER = mask;
+}
+
+uint32_t Timer::ReadCaptureA() const
+{
+	return timer->TC_CHANNEL[channel].TC_RA;
+}
+
+uint32_t Timer::SetPrecision(uint32_t desiredPrecision, uint32_t flags)
 {
 	uint32_t precision;
 	uint8_t idx;
@@ -97,7 +108,7 @@ uint32_t Timer::SetPrecision(uint32_t desiredPrecision)
 	}
 
 	divider = CLOCK_DIVIDERS[idx];
-	Configure(CLOCK_DIVIDERS[idx - 1]);
+	Configure(CLOCK_DIVIDERS[idx - 1] | flags);
 
 	return precision;
 }
@@ -113,45 +124,45 @@ uint32_t Timer::Micros() const
 
 void TC0_Handler()
 {
-	TC_GetStatus(TC0, 0);
+	Timer::HandleInterrupt(0);
 }
 
 void TC1_Handler()
 {
-	TC_GetStatus(TC0, 1);
+	Timer::HandleInterrupt(1);
 }
 
 void TC2_Handler()
 {
-	TC_GetStatus(TC0, 2);
+	Timer::HandleInterrupt(2);
 }
 
 void TC3_Handler()
 {
-	TC_GetStatus(TC1, 0);
+	Timer::HandleInterrupt(3);
 }
 
 void TC4_Handler()
 {
-	TC_GetStatus(TC1, 1);
+	Timer::HandleInterrupt(4);
 }
 
 void TC5_Handler()
 {
-	TC_GetStatus(TC1, 2);
+	Timer::HandleInterrupt(5);
 }
 
 void TC6_Handler()
 {
-	TC_GetStatus(TC2, 0);
+	Timer::HandleInterrupt(6);
 }
 
 void TC7_Handler()
 {
-	TC_GetStatus(TC2, 1);
+	Timer::HandleInterrupt(7);
 }
 
 void TC8_Handler()
 {
-	TC_GetStatus(TC2, 2);
+	Timer::HandleInterrupt(8);
 }
\ No newline at end of file
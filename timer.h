@@ -10,6 +10,8 @@ namespace bothezat
 class Timer
 {
 public:
+	// Called from the interrupt with the status register of the timer channel
+	typedef void (*InterruptHandler)(uint32_t status);
 
 	static const uint8_t CLOCK_DIVIDERS[];
 
@@ -26,15 +28,33 @@ private:
 
 	bool free;
 
+	InterruptHandler handler;
+
 public:
 	void Start();
 	void Stop();
 	uint32_t ReadValue() const;
 	void Configure(uint32_t flags);
 
-	uint32_t SetPrecision(uint32_t desiredPrecision);
+	// Selects the slowest clock with at least the given precision (ns), extra channel mode flags can be passed along
+	uint32_t SetPrecision(uint32_t desiredPrecision, uint32_t flags = 0);
 	uint32_t Micros() const;
 
+	void SetInterruptHandler(InterruptHandler handler) { this->handler = handler; }
+	void EnableInterrupts(uint32_t mask);
+
+	// Value of the counter captured in register A
+	uint32_t ReadCaptureA() const;
+
+	// Converts a tick count to microseconds. The clock usually isn't a whole amount of ticks per microsecond
+	// (MCK/8 is 10.5), so the conversion is split in whole and remaining microseconds to stay exact without overflowing
+	uint32_t TicksToMicros(uint32_t ticks) const
+	{
+		const uint32_t mckPerMicro = VARIANT_MCK / 1000000;
+
+		return (ticks / mckPerMicro) * divider + ((ticks % mckPerMicro) * divider) / mckPerMicro;
+	}
+
 	Timer& operator=(const Timer& other);
 private:
 	Timer(const Timer& other);
@@ -73,9 +93,39 @@ public:
 		return NULL;
 	}
 
+	// Returns a specific timer channel, for functions that are tied to the pins of a channel
+	static Timer* GetTimer(Tc* tc, uint8_t channel)
+	{
+		for (uint8_t timerIdx = 0; timerIdx < TIMER_AMOUNT; ++timerIdx)
+		{
+			Timer* timer = &timerPool[timerIdx];
+
+			if (timer->timer == tc && timer->channel == channel)
+			{
+				assert(timer->free && "Timer is already in use!");
+
+				Debug::Print("Using timer %u\n", timerIdx);
+				timer->free = false;
+				return timer;
+			}
+		}
+
+		return NULL;
+	}
+
 	static void ReleaseTimer(Timer* timer)
 	{
 		timer->free = true;
+		timer->handler = NULL;
+	}
+
+	static void HandleInterrupt(uint8_t timerIdx)
+	{
+		Timer& timer = timerPool[timerIdx];
+		uint32_t status = TC_GetStatus(timer.timer, timer.channel);
+
+		if (timer.handler != NULL)
+			timer.handler(status);
 	}
 
 
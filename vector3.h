@@ -174,6 +174,11 @@ struct Vector3 : public Serializable, public Deserializable
 		return out;
 	}
 
+	static Vector3 Lerp(const Vector3& a, const Vector3& b, float t)
+	{
+		return Vector3(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t);
+	}
+
 	static uint32_t Size() { return sizeof(float) * 3; }
 
 	static Vector3 Zero()		{ return Vector3(); }